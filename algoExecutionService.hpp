@@ -6,18 +6,18 @@
 #include <string>
 #include "marketDataService.hpp"
 #include "executionOrder.hpp"
+#include "objectPool.hpp"
 
 template <typename T>
 class AlgoExecutionOrder {
 private:
-    ExecutionOrder<T>* order_;
+    PoolRef<ExecutionOrder<T>> order_;  // Shared by copies, back to the pool with the last one
     Market market_;
     
 public:
     AlgoExecutionOrder() = default;
-    AlgoExecutionOrder(const T &_product, PricingSide _side, string _orderId, OrderType _orderType, double _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder, Market market);
-    AlgoExecutionOrder(ExecutionOrder<T>& order, Market market);
-    ~AlgoExecutionOrder();
+    AlgoExecutionOrder(ObjectPool<ExecutionOrder<T>>& pool, ProductHandle _product, PricingSide _side, string _orderId, OrderType _orderType, Ticks256 _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder, Market market);
+    AlgoExecutionOrder(ObjectPool<ExecutionOrder<T>>& pool, const ExecutionOrder<T>& order, Market market);
     
     // Fetch the order
     ExecutionOrder<T>* GetExecutionOrder() const;
@@ -32,9 +32,10 @@ class MarketDataToAlgoExecutionListener;
 template <typename T>
 class AlgoExecutionService : public Service<string, AlgoExecutionOrder<T>> {
 private:
-    unordered_map<string, AlgoExecutionOrder<T>> algo_execution_orders_;
+    ObjectPool<ExecutionOrder<T>> order_pool_;  // Declared first, outlives the orders below
+    ProductTable<AlgoExecutionOrder<T>> algo_execution_orders_;
     MarketDataToAlgoExecutionListener<T>* in_listener_;
-    double spread_;
+    Ticks256 spread_;
     long execution_count_;
     
 public:
@@ -58,10 +59,13 @@ public:
     
     // Execute an order on a market
     void AlgoExecute(OrderBook<T>& order_book, Market market = BROKERTEC);
+
+    // Get the pool holding the orders of the service
+    ObjectPool<ExecutionOrder<T>>& GetOrderPool();
 };
 
 template <typename T>
-class MarketDataToAlgoExecutionListener : public ServiceListener<OrderBook<T>> {
+class MarketDataToAlgoExecutionListener final : public ServiceListener<OrderBook<T>> {
 private:
     AlgoExecutionService<T>* service_;
     
@@ -81,21 +85,16 @@ public:
 };
 
 template <typename T>
-AlgoExecutionOrder<T>::AlgoExecutionOrder(const T &_product, PricingSide _side, string _orderId, OrderType _orderType, double _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder, Market market) : market_(market) {
-    this->order_ = new ExecutionOrder<T>(_product, _side, _orderId, _orderType, _price, _visibleQuantity, _hiddenQuantity, _parentOrderId, _isChildOrder);
-}
+AlgoExecutionOrder<T>::AlgoExecutionOrder(ObjectPool<ExecutionOrder<T>>& pool, ProductHandle _product, PricingSide _side, string _orderId, OrderType _orderType, Ticks256 _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder, Market market) :
+    order_(pool.Acquire(_product, _side, std::move(_orderId), _orderType, _price, _visibleQuantity, _hiddenQuantity, std::move(_parentOrderId), _isChildOrder)), market_(market) {}
 
 template <typename T>
-AlgoExecutionOrder<T>::AlgoExecutionOrder(ExecutionOrder<T>& order, Market market) : order_(&order), market_(market) {}
-
-template <typename T>
-AlgoExecutionOrder<T>::~AlgoExecutionOrder() {
-    delete this->order_;
-}
+AlgoExecutionOrder<T>::AlgoExecutionOrder(ObjectPool<ExecutionOrder<T>>& pool, const ExecutionOrder<T>& order, Market market) :
+    order_(pool.Acquire(order)), market_(market) {}
 
 template <typename T>
 ExecutionOrder<T>* AlgoExecutionOrder<T>::GetExecutionOrder() const {
-    return this->order_;
+    return this->order_.Get();
 }
 
 template <typename T>
@@ -104,7 +103,7 @@ Market AlgoExecutionOrder<T>::GetMarket() const {
 }
 
 template <typename T>
-AlgoExecutionService<T>::AlgoExecutionService() : spread_(1. / 128.), execution_count_(0) {
+AlgoExecutionService<T>::AlgoExecutionService() : spread_(2), execution_count_(0) {
     this->in_listener_ = new MarketDataToAlgoExecutionListener<T>(this);
 }
 
@@ -115,14 +114,12 @@ AlgoExecutionService<T>::~AlgoExecutionService() {
 
 template <typename T>
 AlgoExecutionOrder<T>& AlgoExecutionService<T>::GetData(string product_id) {
-    return this->algo_execution_orders_[product_id];
+    return this->algo_execution_orders_[ProductRegistry<T>::Instance().Find(product_id)];
 }
 
 template <typename T>
 void AlgoExecutionService<T>::OnMessage(AlgoExecutionOrder<T>& data) {
-    string product_id = data.GetExecutionOrder()->GetProduct().GetProductId();
-    
-    this->algo_execution_orders_.insert_or_assign(product_id, data);
+    this->algo_execution_orders_.InsertOrAssign(data.GetExecutionOrder()->GetProductHandle(), data);
     
     // Also notify listeners
     for (auto& listener : Service<string, AlgoExecutionOrder<T>>::listeners_) {
@@ -148,19 +145,22 @@ MarketDataToAlgoExecutionListener<T>* AlgoExecutionService<T>::GetInListener() {
 template <typename T>
 void AlgoExecutionService<T>::AlgoExecute(OrderBook<T>& order_book, Market market) {
 
+    // An empty side reports price 0, never cross into it
+    if (!order_book.IsTwoSided()) return;
+
     // initialize
-    T product = order_book.GetProduct();
+    ProductHandle product = order_book.GetProductHandle();
     PricingSide side;
-    double price;
+    Ticks256 price;
     long quantity;
     
     // Get the current best bid/offer
-    BidOffer bid_offer = order_book.GetBidOffer();
-    Order bid_order = bid_offer.GetBidOrder();
-    double bid_price = bid_order.GetPrice();
+    const BidOffer& bid_offer = order_book.GetBidOffer();
+    const Order& bid_order = bid_offer.GetBidOrder();
+    Ticks256 bid_price = bid_order.GetPrice();
     long bid_quantity = bid_order.GetQuantity();
-    Order offer_order = bid_offer.GetOfferOrder();
-    double offer_price = offer_order.GetPrice();
+    const Order& offer_order = bid_offer.GetOfferOrder();
+    Ticks256 offer_price = offer_order.GetPrice();
     long offer_quantity = offer_order.GetQuantity();
     
     // If the spread is no more than the designated threshold, cross the spread alternatingly
@@ -176,7 +176,7 @@ void AlgoExecutionService<T>::AlgoExecute(OrderBook<T>& order_book, Market marke
         }
         execution_count_++;
         
-        AlgoExecutionOrder<T> algo_execution_order(product, side, "", MARKET, price, quantity, 0, "", false, market);
+        AlgoExecutionOrder<T> algo_execution_order(order_pool_, product, side, "", MARKET, price, quantity, 0, "", false, market);
         
         // Notify listeners
         for (auto& l : Service<string, AlgoExecutionOrder<T>>::listeners_) {
@@ -185,6 +185,11 @@ void AlgoExecutionService<T>::AlgoExecute(OrderBook<T>& order_book, Market marke
     }
 }
 
+template <typename T>
+ObjectPool<ExecutionOrder<T>>& AlgoExecutionService<T>::GetOrderPool() {
+    return this->order_pool_;
+}
+
 template<typename T>
 MarketDataToAlgoExecutionListener<T>::MarketDataToAlgoExecutionListener(AlgoExecutionService<T>* service) : service_(service) {}
 
@@ -4,28 +4,28 @@
 
 #include "priceStream.hpp"
 #include "soa.hpp"
+#include "objectPool.hpp"
 #include <unordered_map>
 
 template<typename T>
 class AlgoStream {
 private:
-    PriceStream<T>* price_stream_;
+    PoolRef<PriceStream<T>> price_stream_;  // Shared by copies, back to the pool with the last one
 
 public:
     AlgoStream() = default;
-    AlgoStream(const T& product, const PriceStreamOrder& bid_order, const PriceStreamOrder& offer_order);
+    AlgoStream(ObjectPool<PriceStream<T>>& pool, ProductHandle product, const PriceStreamOrder& bid_order, const PriceStreamOrder& offer_order);
 
     PriceStream<T>* GetPriceStream() const;
 };
 
 template<typename T>
-AlgoStream<T>::AlgoStream(const T& product, const PriceStreamOrder& bid_order, const PriceStreamOrder& offer_order) {
-    this->price_stream_ = new PriceStream<T>(product, bid_order, offer_order);
-}
+AlgoStream<T>::AlgoStream(ObjectPool<PriceStream<T>>& pool, ProductHandle product, const PriceStreamOrder& bid_order, const PriceStreamOrder& offer_order) :
+    price_stream_(pool.Acquire(product, bid_order, offer_order)) {}
 
 template<typename T>
 PriceStream<T>* AlgoStream<T>::GetPriceStream() const {
-    return this->price_stream_;
+    return this->price_stream_.Get();
 }
 
 template<typename T>
@@ -34,9 +34,10 @@ class PricingToAlgoStreamingListener;
 template<typename T>
 class AlgoStreamingService : public Service<string, AlgoStream<T>> {
 private:
-    unordered_map<string, AlgoStream<T>> algo_streams_;
-    ServiceListener<Price<T>>* in_listener_;
-    long count_;
+    ObjectPool<PriceStream<T>> stream_pool_;  // Declared first, outlives the streams below
+    ProductTable<AlgoStream<T>> algo_streams_;
+    PricingToAlgoStreamingListener<T>* in_listener_;
+    ProductTable<long> publish_counts_;  // Per product, so shards alternate sizes as a serial run does
     
 public:
     AlgoStreamingService();
@@ -56,13 +57,16 @@ public:
     virtual const vector<ServiceListener<AlgoStream<T>>*>& GetListeners() const override;
     
     // Get the listener of the service
-    ServiceListener<Price<T>>* GetInListener();
+    PricingToAlgoStreamingListener<T>* GetInListener();
     
     void AlgoPublishPrice(Price<T>& price);
+
+    // Get the pool holding the price streams of the service
+    ObjectPool<PriceStream<T>>& GetStreamPool();
 };
 
 template<typename T>
-class PricingToAlgoStreamingListener : public ServiceListener<Price<T>> {
+class PricingToAlgoStreamingListener final : public ServiceListener<Price<T>> {
 private:
     AlgoStreamingService<T>* service_;
 
@@ -84,7 +88,6 @@ public:
 template<typename T>
 AlgoStreamingService<T>::AlgoStreamingService() {
     this->in_listener_ = new PricingToAlgoStreamingListener<T>(this);
-    this->count_ = 0;
 }
 
 template<typename T>
@@ -94,13 +97,12 @@ AlgoStreamingService<T>::~AlgoStreamingService() {
 
 template <typename T>
 AlgoStream<T>& AlgoStreamingService<T>::GetData(string product_id) {
-    return this->algo_streams_[product_id];
+    return this->algo_streams_[ProductRegistry<T>::Instance().Find(product_id)];
 }
 
 template <typename T>
 void AlgoStreamingService<T>::OnMessage(AlgoStream<T>& data) {
-    string product_id = data.GetPriceStream()->GetProduct().GetProductId();
-    this->algo_streams_[product_id] = data;
+    this->algo_streams_[data.GetPriceStream()->GetProductHandle()] = data;
 }
 
 template <typename T>
@@ -114,27 +116,26 @@ const vector<ServiceListener<AlgoStream<T>>*>& AlgoStreamingService<T>::GetListe
 }
 
 template <typename T>
-ServiceListener<Price<T>>* AlgoStreamingService<T>::GetInListener() {
+PricingToAlgoStreamingListener<T>* AlgoStreamingService<T>::GetInListener() {
     return this->in_listener_;
 }
 
 template<typename T>
 void AlgoStreamingService<T>::AlgoPublishPrice(Price<T>& price)
 {
-    T product = price.GetProduct();
-    string product_id = product.GetProductId();
-
-    double mid = price.GetMid();
-    double spread = price.GetBidOfferSpread();
-    double bid_price = mid - spread / 2.;
-    double offer_price = mid + spread / 2.;
-    long visible_quantity = ((count_++) % 2 + 1) * 1000000;  // Alternate visble sizes
+    ProductHandle product = price.GetProductHandle();
+
+    Ticks256 mid = price.GetMid();
+    Ticks256 spread = price.GetBidOfferSpread();
+    Ticks256 bid_price = mid - spread / 2;
+    Ticks256 offer_price = bid_price + spread;
+    long visible_quantity = (this->publish_counts_[product]++ % 2 + 1) * 1000000;  // Alternate visible sizes per product
     long hidden_quantity = visible_quantity * 2;
 
     PriceStreamOrder bid_order(bid_price, visible_quantity, hidden_quantity, BID);
     PriceStreamOrder offer_order(offer_price, visible_quantity, hidden_quantity, OFFER);
-    AlgoStream<T> algo_stream(product, bid_order, offer_order);
-    this->algo_streams_[product_id] = algo_stream;
+    AlgoStream<T> algo_stream(stream_pool_, product, bid_order, offer_order);
+    this->algo_streams_[product] = algo_stream;
 
     for (auto& listener : this->GetListeners())
     {
@@ -142,6 +143,11 @@ void AlgoStreamingService<T>::AlgoPublishPrice(Price<T>& price)
     }
 }
 
+template<typename T>
+ObjectPool<PriceStream<T>>& AlgoStreamingService<T>::GetStreamPool() {
+    return this->stream_pool_;
+}
+
 template<typename T>
 PricingToAlgoStreamingListener<T>::PricingToAlgoStreamingListener(AlgoStreamingService<T>* service) : service_(service) {}
 
@@ -0,0 +1,683 @@
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "soa.hpp"
+#include "products.hpp"
+#include "utilities.hpp"
+#include "mappedFile.hpp"
+#include "marketDataService.hpp"
+#include "executionOrder.hpp"
+#include "algoExecutionService.hpp"
+#include "executionService.hpp"
+#include "tradeBookingService.hpp"
+#include "positionService.hpp"
+#include "riskService.hpp"
+#include "scenarioRisk.hpp"
+#include "curveService.hpp"
+#include "pricingService.hpp"
+#include "priceStream.hpp"
+#include "algoStreamingService.hpp"
+#include "streamingService.hpp"
+#include "historicalDataService.hpp"
+#include "inquiryService.hpp"
+#include "guiService.hpp"
+
+// Directory holding prices.txt, trades.txt and inquiries.txt
+#ifndef TRADINGSYSTEM_DATA_DIR
+#define TRADINGSYSTEM_DATA_DIR "."
+#endif
+
+// Number of operator new calls made by the process, to check hot paths allocate nothing
+std::atomic<std::int64_t> allocation_count(0);
+
+// Every replaceable operator new and delete goes through these two, kept out of line so the
+// compiler never pairs a new expression with the free behind it
+__attribute__((noinline)) void* CountedAllocate(std::size_t size, std::size_t alignment) noexcept {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+    void* p = nullptr;
+    return (::posix_memalign(&p, alignment, size) == 0) ? p : nullptr;
+}
+
+__attribute__((noinline)) void CountedFree(void* p) noexcept {
+    std::free(p);
+}
+
+void* operator new(std::size_t size) {
+    if (void* p = CountedAllocate(size, 0)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* p = CountedAllocate(size, 0)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* p = CountedAllocate(size, std::size_t(alignment))) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    if (void* p = CountedAllocate(size, std::size_t(alignment))) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return CountedAllocate(size, 0);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return CountedAllocate(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return CountedAllocate(size, std::size_t(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return CountedAllocate(size, std::size_t(alignment));
+}
+
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { CountedFree(p); }
+
+// Cusip of the first on-the-run bond
+const std::string& BenchCusip() {
+    static const std::string cusip = kBondMapMaturity.begin()->second.first;
+    return cusip;
+}
+
+// Stack of orders for one side at the given depth, two orders resting at most prices
+std::vector<Order> MakeStack(std::size_t depth, PricingSide side) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<long> offset(0, long(depth / 2));
+    std::vector<Order> stack;
+    stack.reserve(depth);
+    for (std::size_t i = 0; i < depth; i++) {
+        long ticks = (side == BID) ? 99 * 256 - offset(generator) : 99 * 256 + 1 + offset(generator);
+        stack.push_back(Order(Ticks256(ticks), 1000000 * long(1 + i % 5), side));
+    }
+    return stack;
+}
+
+// Sort-merge aggregation of a raw stack into price levels
+void BM_AggregateOrders(benchmark::State& state) {
+    std::size_t depth = std::size_t(state.range(0));
+    const std::vector<Order> original = MakeStack(depth, OFFER);
+    std::vector<Order> stack(original);
+    for (auto _ : state) {
+        stack.assign(original.begin(), original.end());
+        benchmark::DoNotOptimize(AggregateOrders(stack.data(), stack.size(), OFFER));
+    }
+    state.SetItemsProcessed(state.iterations() * std::int64_t(depth));
+}
+BENCHMARK(BM_AggregateOrders)->Arg(5)->Arg(10)->Arg(50)->Arg(500);
+
+// Bond notation to ticks
+void BM_ConvertPriceToTicks(benchmark::State& state) {
+    std::string_view price("99-16+");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(price);
+        benchmark::DoNotOptimize(ConvertPrice(price));
+    }
+}
+BENCHMARK(BM_ConvertPriceToTicks);
+
+// Ticks to bond notation
+void BM_ConvertPriceToString(benchmark::State& state) {
+    Ticks256 price(99 * Ticks256::kTicksPerPoint + 132);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(price);
+        benchmark::DoNotOptimize(ConvertPrice(price));
+    }
+}
+BENCHMARK(BM_ConvertPriceToString);
+
+// The price parser this repository started from, a float through temporary strings for stoi
+float LegacyConvertPrice(const std::string& str_price) {
+    auto delimiter_pos = str_price.find('-');
+    float res = std::stoi(str_price.substr(0, delimiter_pos));
+    res += std::stoi(str_price.substr(delimiter_pos + 1, 2)) / 32.;
+    char last_char = str_price[delimiter_pos + 3];
+    if (last_char == '+') {
+        res += 1. / 64.;
+    } else {
+        res += (last_char - '0') / 256.;
+    }
+    return res;
+}
+
+// Every price quoted in prices.txt (bid and offer) and trades.txt, in file order
+const std::vector<std::string>& LoadQuotedPrices() {
+    static const std::vector<std::string> prices = []() {
+        std::vector<std::string> loaded;
+        const std::pair<const char*, std::vector<std::size_t>> files[] = { { "prices.txt", { 1, 2 } }, { "trades.txt", { 2 } } };
+        for (const auto& [file_name, columns] : files) {
+            MappedFile data(std::string(TRADINGSYSTEM_DATA_DIR) + "/" + file_name);
+            LineReader reader(data.GetView());
+            std::string_view line;
+            std::string_view fields[6];
+            while (reader.Next(line)) {
+                if (line.empty()) continue;
+                std::size_t count = SplitLine(line, fields, 6);
+                for (std::size_t column : columns) {
+                    if (column < count) loaded.emplace_back(fields[column]);
+                }
+            }
+        }
+        return loaded;
+    }();
+    return prices;
+}
+
+// Parsing every price of the input files: 0 the original string parser, 1 the tick parser
+void BM_ParseQuotedPrices(benchmark::State& state) {
+    const std::vector<std::string>& prices = LoadQuotedPrices();
+    if (prices.empty()) {
+        state.SkipWithError("cannot open prices.txt or trades.txt");
+        return;
+    }
+    std::vector<std::string_view> views(prices.begin(), prices.end());
+    std::vector<long> ticks(prices.size());
+
+    // Both parsers must agree before their speed means anything
+    for (std::size_t i = 0; i < prices.size(); i++) {
+        if (!ParsePriceTicks(views[i], ticks[i])
+            || LegacyConvertPrice(prices[i]) != float(ticks[i]) / Ticks256::kTicksPerPoint) {
+            state.SkipWithError(("parsers disagree on " + prices[i]).c_str());
+            return;
+        }
+    }
+
+    int parser = int(state.range(0));
+    for (auto _ : state) {
+        if (parser == 0) {
+            for (const std::string& price : prices) benchmark::DoNotOptimize(LegacyConvertPrice(price));
+        } else {
+            for (std::size_t i = 0; i < views.size(); i++) ParsePriceTicks(views[i], ticks[i]);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * std::int64_t(prices.size()));
+}
+BENCHMARK(BM_ParseQuotedPrices)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// Cusip lookup of a bond
+void BM_FetchBond(benchmark::State& state) {
+    std::string_view cusip(BenchCusip());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cusip);
+        benchmark::DoNotOptimize(&FetchBond(cusip));
+    }
+}
+BENCHMARK(BM_FetchBond);
+
+// Best bid and offer of a book
+void BM_GetBidOffer(benchmark::State& state) {
+    OrderBook<Bond> book(FetchBondHandle(BenchCusip()), MakeStack(10, BID), MakeStack(10, OFFER));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(&book.GetBidOffer());
+    }
+}
+BENCHMARK(BM_GetBidOffer);
+
+// Aggregated book of a product held by the service
+void BM_AggregateDepth(benchmark::State& state) {
+    MarketDataService<Bond> service;
+    std::vector<Order> bids = MakeStack(10, BID);
+    std::vector<Order> offers = MakeStack(10, OFFER);
+    service.OnSnapshot(FetchBondHandle(BenchCusip()), bids, offers);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(&service.AggregateDepth(BenchCusip()));
+    }
+}
+BENCHMARK(BM_AggregateDepth);
+
+// Booking a trade into one of three books of a position
+void BM_PositionAddPosition(benchmark::State& state) {
+    Position<Bond> position(FetchBondHandle(BenchCusip()));
+    BookRegistry& registry = BookRegistry::Instance();
+    BookHandle books[3] = { registry.Intern("TRSY1"), registry.Intern("TRSY2"), registry.Intern("TRSY3") };
+    std::size_t i = 0;
+    for (auto _ : state) {
+        BookHandle book = books[i % 3];
+        Side side = (i & 1) ? BUY : SELL;
+        position.AddPosition(book, 1000000, side);
+        i++;
+    }
+    benchmark::DoNotOptimize(position.GetAggregatePosition());
+}
+BENCHMARK(BM_PositionAddPosition);
+
+// Risking a position, without listeners
+void BM_RiskServiceAddPosition(benchmark::State& state) {
+    RiskService<Bond> service;
+    Position<Bond> position(FetchBondHandle(BenchCusip()));
+    std::string book("TRSY1");
+    position.AddPosition(book, 1000000, BUY);
+    for (auto _ : state) {
+        service.AddPosition(position);
+    }
+}
+BENCHMARK(BM_RiskServiceAddPosition);
+
+// Risking a position of a product in a registered sector, moving the sector total
+void BM_RiskServiceAddPositionBucketed(benchmark::State& state) {
+    RiskService<Bond> service;
+    for (const auto& sector : MakeTreasurySectors()) service.AddBucketedSector(sector);
+    Position<Bond> position(FetchBondHandle(BenchCusip()));
+    position.AddPosition("TRSY1", 1000000, BUY);
+    for (auto _ : state) {
+        service.AddPosition(position);
+    }
+}
+BENCHMARK(BM_RiskServiceAddPositionBucketed);
+
+// Reading a sector total, as the GUI or limits would from another thread
+void BM_GetBucketedRisk(benchmark::State& state) {
+    RiskService<Bond> service;
+    ProductHandle sector = service.AddBucketedSector(MakeTreasurySectors().front());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(service.GetBucketedRisk(sector).GetPV01());
+    }
+}
+BENCHMARK(BM_GetBucketedRisk);
+
+// Solving a price for yield and risk on every tick, against the per tick cache
+// Prices walk 128 ticks around par as a live mid would
+void BM_BondRisk(benchmark::State& state) {
+    BondAnalytics<Bond> analytics(kSettlementDate);
+    ProductHandle product = FetchBondHandle(FetchCusip(30));
+    bool is_cached = state.range(0) != 0;
+    long par = 100 * Ticks256::kTicksPerPoint;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        Ticks256 price(par - 64 + long(i++ % 128));
+        if (is_cached) {
+            benchmark::DoNotOptimize(analytics.GetRisk(product, price).pv01);
+        } else {
+            benchmark::DoNotOptimize(analytics.ComputeRisk(product, price).pv01);
+        }
+    }
+}
+BENCHMARK(BM_BondRisk)->Arg(0)->Arg(1);
+
+// Re-risking a booked position on a new mid, moving its sector
+void BM_RiskServiceAddPrice(benchmark::State& state) {
+    RiskService<Bond> service;
+    for (const auto& sector : MakeTreasurySectors()) service.AddBucketedSector(sector);
+    ProductHandle product = FetchBondHandle(BenchCusip());
+    Position<Bond> position(product);
+    position.AddPosition("TRSY1", 1000000, BUY);
+    service.AddPosition(position);
+    long par = 100 * Ticks256::kTicksPerPoint;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        Price<Bond> price(product, Ticks256(par - 64 + long(i++ % 128)), Ticks256(2));
+        service.AddPrice(price);
+    }
+}
+BENCHMARK(BM_RiskServiceAddPrice);
+
+// Moving one benchmark of the curve and republishing it, as each tick of prices.txt does
+void BM_CurveAddPrice(benchmark::State& state) {
+    CurveService<Bond> service("UST", MakeTreasuryBenchmarks());
+    std::vector<ProductHandle> benchmarks;
+    for (const auto& [maturity, bond] : kBondMapMaturity) benchmarks.push_back(FetchBondHandle(bond.first));
+    long par = 100 * Ticks256::kTicksPerPoint;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        Price<Bond> price(benchmarks[i % benchmarks.size()], Ticks256(par - 64 + long((i * 13) % 128)), Ticks256(2));
+        service.AddPrice(price);
+        i++;
+    }
+    benchmark::DoNotOptimize(service.GetCurve()->GetVersion());
+}
+BENCHMARK(BM_CurveAddPrice);
+
+// Repricing the scenario grid after a position change, steps^3 scenarios over the worker pool
+void BM_ScenarioRecompute(benchmark::State& state) {
+    std::size_t steps = std::size_t(state.range(0));
+    std::vector<double> tenors;
+    for (const auto& [maturity, bond] : kBondMapMaturity) tenors.push_back(maturity);
+    ScenarioRiskEngine<Bond> engine(tenors, std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+    BondAnalytics<Bond> analytics(kSettlementDate);
+    long quantity = 1000000;
+    for (const auto& [maturity, bond] : kBondMapMaturity) {
+        ProductHandle product = FetchBondHandle(bond.first);
+        const BondRisk& risk = analytics.GetRisk(product, Ticks256(100 * Ticks256::kTicksPerPoint));
+        engine.AddProduct(product, maturity, risk.pv01, risk.gamma);
+        engine.UpdatePosition(product, quantity);
+        quantity = -2 * quantity;
+    }
+    engine.SetScenarios(MakeShockGrid(50., steps));
+    for (auto _ : state) {
+        engine.Recompute();
+    }
+    benchmark::DoNotOptimize(engine.GetSnapshot()->worst_scenario);
+    state.SetItemsProcessed(state.iterations() * std::int64_t(engine.GetScenarioCount()));
+}
+BENCHMARK(BM_ScenarioRecompute)->Arg(11)->Arg(21)->Arg(41)->Unit(benchmark::kMicrosecond);
+
+// Formatting a record as persisted by the historical services
+template<typename V>
+void BM_ToString(benchmark::State& state, const V& record) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(record.ToString());
+    }
+}
+
+Position<Bond> MakeBenchPosition() {
+    Position<Bond> position(FetchBondHandle(BenchCusip()));
+    std::string books[3] = { "TRSY1", "TRSY2", "TRSY3" };
+    for (auto& book : books) position.AddPosition(book, 1000000, BUY);
+    return position;
+}
+
+ProductHandle BenchHandle() {
+    return FetchBondHandle(BenchCusip());
+}
+
+BENCHMARK_CAPTURE(BM_ToString, Price, Price<Bond>(BenchHandle(), ConvertPrice("99-16+"), ConvertPrice("0-010")));
+BENCHMARK_CAPTURE(BM_ToString, PriceStream, PriceStream<Bond>(BenchHandle(),
+    PriceStreamOrder(ConvertPrice("99-160"), 1000000, 2000000, BID),
+    PriceStreamOrder(ConvertPrice("99-162"), 1000000, 2000000, OFFER)));
+BENCHMARK_CAPTURE(BM_ToString, ExecutionOrder, ExecutionOrder<Bond>(BenchHandle(), BID, "ORDER000001", MARKET,
+    ConvertPrice("99-160"), 1000000, 0, "PARENT000001", false));
+BENCHMARK_CAPTURE(BM_ToString, Position, MakeBenchPosition());
+BENCHMARK_CAPTURE(BM_ToString, PV01, PV01<Bond>(BenchHandle(), 0.019851, 3000000));
+BENCHMARK_CAPTURE(BM_ToString, Inquiry, Inquiry<Bond>("INQUIRY000001", BenchHandle(), BUY, 1000000,
+    ConvertPrice("99-160"), RECEIVED));
+
+// Listener counting its events, final so a chain calls it directly
+template<typename V>
+class CountingListener final : public ServiceListener<V> {
+public:
+    long count = 0;
+    void ProcessAdd(V&) override { count++; }
+    void ProcessRemove(V&) override {}
+    void ProcessUpdate(V&) override {}
+};
+
+// A price fanning out to four listeners: 0 each registered with AddListener, a virtual
+// call per listener, 1 one compile-time chain registered, a virtual call into the chain
+void BM_ListenerFanOut(benchmark::State& state) {
+    PricingService<Bond> service;
+    CountingListener<Price<Bond>> listeners[4];
+    auto chain = MakeListenerChain(&listeners[0], &listeners[1], &listeners[2], &listeners[3]);
+    if (state.range(0) == 0) {
+        for (auto& listener : listeners) service.AddListener(&listener);
+    } else {
+        service.AddListener(&chain);
+    }
+    Price<Bond> price(FetchBondHandle(BenchCusip()), ConvertPrice("99-16+"), ConvertPrice("0-010"));
+    for (auto _ : state) {
+        service.OnMessage(price);
+    }
+    benchmark::DoNotOptimize(listeners[3].count);
+}
+BENCHMARK(BM_ListenerFanOut)->Arg(0)->Arg(1);
+
+// Listener holding on to the last few events, so pooled payloads are still shared
+// when the service replaces them
+template<typename V>
+class RetainingListener final : public ServiceListener<V> {
+private:
+    V retained_[8];
+    std::size_t count_ = 0;
+
+public:
+    void ProcessAdd(V& data) override { retained_[count_++ % 8] = data; }
+    void ProcessRemove(V&) override {}
+    void ProcessUpdate(V&) override {}
+};
+
+// Report the allocations made per iteration after warming up, 0 once the pools hold
+// the working set
+void ReportAllocations(benchmark::State& state, std::int64_t allocations_before) {
+    state.counters["allocations/tick"] = double(allocation_count.load() - allocations_before) / double(state.iterations());
+}
+
+// Report the allocations made per iteration after warming up, failing the benchmark on any,
+// for paths whose pools must hold the whole working set
+void ExpectNoAllocations(benchmark::State& state, std::int64_t allocations_before) {
+    std::int64_t allocations = allocation_count.load() - allocations_before;
+    ReportAllocations(state, allocations_before);
+    if (allocations != 0) {
+        state.SkipWithError(("allocations in steady state: " + std::to_string(allocations)).c_str());
+    }
+}
+
+// Streaming prices of seven products through the algo, its stream pool recycling payloads
+void BM_AlgoPublishPrice(benchmark::State& state) {
+    AlgoStreamingService<Bond> service;
+    RetainingListener<AlgoStream<Bond>> listener;
+    service.AddListener(&listener);
+    std::vector<Price<Bond>> prices;
+    for (const auto& bond : kBondMapMaturity) {
+        prices.push_back(Price<Bond>(FetchBondHandle(bond.second.first), ConvertPrice("99-16+"), ConvertPrice("0-010")));
+    }
+    for (std::size_t i = 0; i < 1024; i++) service.AlgoPublishPrice(prices[i % prices.size()]);
+
+    std::size_t i = 0;
+    std::int64_t allocations_before = allocation_count.load();
+    for (auto _ : state) {
+        service.AlgoPublishPrice(prices[i++ % prices.size()]);
+    }
+    ExpectNoAllocations(state, allocations_before);
+}
+BENCHMARK(BM_AlgoPublishPrice);
+
+// Executing against a tight book, the order pool recycling payloads
+void BM_AlgoExecute(benchmark::State& state) {
+    AlgoExecutionService<Bond> service;
+    RetainingListener<AlgoExecutionOrder<Bond>> listener;
+    service.AddListener(&listener);
+    OrderBook<Bond> book(BenchHandle(), MakeStack(10, BID), MakeStack(10, OFFER));
+    for (std::size_t i = 0; i < 1024; i++) service.AlgoExecute(book);
+
+    std::int64_t allocations_before = allocation_count.load();
+    for (auto _ : state) {
+        service.AlgoExecute(book);
+    }
+    ExpectNoAllocations(state, allocations_before);
+}
+BENCHMARK(BM_AlgoExecute);
+
+// Every message handed between services moves without throwing
+static_assert(std::is_nothrow_move_constructible<Price<Bond>>::value && std::is_nothrow_move_assignable<Price<Bond>>::value, "Price move");
+static_assert(std::is_nothrow_move_constructible<Trade<Bond>>::value && std::is_nothrow_move_assignable<Trade<Bond>>::value, "Trade move");
+static_assert(std::is_nothrow_move_constructible<Inquiry<Bond>>::value && std::is_nothrow_move_assignable<Inquiry<Bond>>::value, "Inquiry move");
+static_assert(std::is_nothrow_move_constructible<Position<Bond>>::value && std::is_nothrow_move_assignable<Position<Bond>>::value, "Position move");
+static_assert(std::is_nothrow_move_constructible<ExecutionOrder<Bond>>::value && std::is_nothrow_move_assignable<ExecutionOrder<Bond>>::value, "ExecutionOrder move");
+static_assert(std::is_nothrow_move_constructible<PriceStream<Bond>>::value && std::is_nothrow_move_assignable<PriceStream<Bond>>::value, "PriceStream move");
+
+// A position with its books fits one cache line
+static_assert(sizeof(Position<Bond>) <= 64, "Position size");
+
+// Booking a stream of new trades, handed to the service by copy (0) or by move (1)
+// Trade ids are longer than the small string buffer, so each copy of a trade costs one
+// allocation: allocations/tick counts the parse, the map node, its key and the copies
+void BM_TradeHandoff(benchmark::State& state) {
+    const std::size_t kTradesPerService = 4096;
+    std::vector<std::string> lines;
+    for (std::size_t i = 0; i < kTradesPerService; i++) {
+        lines.push_back(BenchCusip() + ",TRADE-" + BenchCusip() + "-" + std::to_string(1000000 + i) + ",99-160,TRSY1,1000000,BUY");
+    }
+
+    bool by_move = state.range(0) != 0;
+    std::unique_ptr<TradeBookingService<Bond>> service;
+    std::size_t i = 0;
+    std::int64_t allocations_before = allocation_count.load();
+    for (auto _ : state) {
+        // A fresh service every pass over the lines keeps every trade id new
+        if (i++ % kTradesPerService == 0) {
+            state.PauseTiming();
+            std::int64_t allocations_paused = allocation_count.load();
+            service.reset(new TradeBookingService<Bond>());
+            allocations_before += allocation_count.load() - allocations_paused;
+            state.ResumeTiming();
+        }
+        Trade<Bond> trade = service->GetConnector()->Parse(lines[(i - 1) % kTradesPerService]);
+        if (by_move) {
+            service->OnMessage(std::move(trade));
+        } else {
+            service->OnMessage(trade);
+        }
+    }
+    ReportAllocations(state, allocations_before);
+}
+BENCHMARK(BM_TradeHandoff)->Arg(0)->Arg(1);
+
+// Fresh temporary directory made the working directory for its lifetime, then removed
+class ScratchDirectory {
+public:
+    ScratchDirectory() : previous_(std::filesystem::current_path()) {
+        std::string path = (std::filesystem::temp_directory_path() / "tradingsystem_bench.XXXXXX").string();
+        if (::mkdtemp(path.data()) == nullptr) throw std::runtime_error("ScratchDirectory: cannot create " + path);
+        path_ = path;
+        std::filesystem::current_path(path_);
+    }
+    ~ScratchDirectory() {
+        std::filesystem::current_path(previous_);
+        std::error_code error;
+        std::filesystem::remove_all(path_, error);
+    }
+    ScratchDirectory(const ScratchDirectory&) = delete;
+    ScratchDirectory& operator = (const ScratchDirectory&) = delete;
+
+private:
+    std::filesystem::path previous_;
+    std::filesystem::path path_;
+};
+
+// Build the service graph of main.cpp, every listener running on the calling thread and
+// scenario risk recomputing on its engine thread as in a sequential run, then run body
+// with the services fed by the input files
+template<typename Body>
+void RunOnTradingGraph(Body body) {
+    // The stores and the GUI write into the working directory, keep them out of the caller's
+    ScratchDirectory scratch;
+    PricingService<Bond> pricing_service;
+    TradeBookingService<Bond> trade_booking_service;
+    PositionService<Bond> position_service;
+    RiskService<Bond> risk_service;
+    CurveService<Bond> curve_service("UST", MakeTreasuryBenchmarks());
+    MarketDataService<Bond> market_data_service;
+    AlgoExecutionService<Bond> algo_execution_service;
+    AlgoStreamingService<Bond> algo_streaming_service;
+    GUIService<Bond> gui_service;
+    ExecutionService<Bond> execution_service;
+    StreamingService<Bond> streaming_service;
+    InquiryService<Bond> inquiry_service;
+    HistoricalDataService<Position<Bond>> historical_position_service(POSITION);
+    HistoricalDataService<PV01<Bond>> historical_risk_service(RISK);
+    HistoricalDataService<ExecutionOrder<Bond>> historical_execution_service(EXECUTION);
+    HistoricalDataService<PriceStream<Bond>> historical_streaming_service(STREAMING);
+    HistoricalDataService<Inquiry<Bond>> historical_inquiry_service(INQUIRY);
+
+    std::vector<double> key_rate_tenors;
+    for (const auto& [maturity, bond] : kBondMapMaturity) key_rate_tenors.push_back(maturity);
+    ScenarioRiskEngine<Bond> scenario_risk_engine(key_rate_tenors);
+    BondAnalytics<Bond> analytics(kSettlementDate);
+    for (const auto& [maturity, bond] : kBondMapMaturity) {
+        ProductHandle product = FetchBondHandle(bond.first);
+        const BondRisk& risk = analytics.GetRisk(product, Ticks256(100 * Ticks256::kTicksPerPoint));
+        scenario_risk_engine.AddProduct(product, maturity, risk.pv01, risk.gamma);
+    }
+    scenario_risk_engine.SetScenarios(MakeShockGrid(50., 21));
+    PositionToScenarioRiskListener<Bond> scenario_risk_listener(&scenario_risk_engine);
+
+    auto pricing_listeners = MakeListenerChain(algo_streaming_service.GetInListener(), risk_service.GetPriceListener(),
+        curve_service.GetInListener(), gui_service.GetInListener());
+    auto algo_streaming_listeners = MakeListenerChain(streaming_service.GetInListener());
+    auto streaming_listeners = MakeListenerChain(historical_streaming_service.GetInListener());
+    auto market_data_listeners = MakeListenerChain(algo_execution_service.GetInListener());
+    auto algo_execution_listeners = MakeListenerChain(execution_service.GetInListener());
+    auto execution_listeners = MakeListenerChain(trade_booking_service.GetInListener(), historical_execution_service.GetInListener());
+    auto trade_booking_listeners = MakeListenerChain(position_service.GetInListener());
+    auto position_listeners = MakeListenerChain(risk_service.GetInListener(), &scenario_risk_listener, historical_position_service.GetInListener());
+    auto risk_listeners = MakeListenerChain(historical_risk_service.GetInListener());
+    auto inquiry_listeners = MakeListenerChain(historical_inquiry_service.GetInListener());
+
+    pricing_service.AddListener(&pricing_listeners);
+    algo_streaming_service.AddListener(&algo_streaming_listeners);
+    streaming_service.AddListener(&streaming_listeners);
+    market_data_service.AddListener(&market_data_listeners);
+    algo_execution_service.AddListener(&algo_execution_listeners);
+    execution_service.AddListener(&execution_listeners);
+    trade_booking_service.AddListener(&trade_booking_listeners);
+    position_service.AddListener(&position_listeners);
+    risk_service.AddListener(&risk_listeners);
+    inquiry_service.AddListener(&inquiry_listeners);
+    for (const auto& sector : MakeTreasurySectors()) {
+        risk_service.AddBucketedSector(sector);
+    }
+    scenario_risk_engine.Start();
+
+    body(pricing_service, trade_booking_service, inquiry_service);
+    scenario_risk_engine.Stop();
+}
+
+// Replay one input file through the full graph, reporting messages per second
+// Connector selects the connector of the service the file feeds
+template<typename Connector>
+void ReplayFile(benchmark::State& state, const std::string& file_name, Connector connector) {
+    MappedFile data(std::string(TRADINGSYSTEM_DATA_DIR) + "/" + file_name);
+    if (!data.IsOpen()) {
+        state.SkipWithError(("cannot open " + file_name).c_str());
+        return;
+    }
+
+    std::int64_t messages = 0;
+    LineReader reader(data.GetView());
+    std::string_view line;
+    while (reader.Next(line)) {
+        if (!line.empty()) messages++;
+    }
+
+    RunOnTradingGraph([&](auto& pricing_service, auto& trade_booking_service, auto& inquiry_service) {
+        for (auto _ : state) {
+            connector(pricing_service, trade_booking_service, inquiry_service)->Subscribe(data);
+        }
+    });
+    state.counters["messages/s"] = benchmark::Counter(double(state.iterations() * messages), benchmark::Counter::kIsRate);
+}
+
+void BM_ReplayPrices(benchmark::State& state) {
+    ReplayFile(state, "prices.txt", [](auto& pricing, auto&, auto&) { return pricing.GetConnector(); });
+}
+BENCHMARK(BM_ReplayPrices)->Unit(benchmark::kMillisecond);
+
+void BM_ReplayTrades(benchmark::State& state) {
+    ReplayFile(state, "trades.txt", [](auto&, auto& trade_booking, auto&) { return trade_booking.GetConnector(); });
+}
+BENCHMARK(BM_ReplayTrades)->Unit(benchmark::kMicrosecond);
+
+void BM_ReplayInquiries(benchmark::State& state) {
+    ReplayFile(state, "inquiries.txt", [](auto&, auto&, auto& inquiry) { return inquiry.GetConnector(); });
+}
+BENCHMARK(BM_ReplayInquiries)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
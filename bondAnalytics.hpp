@@ -0,0 +1,231 @@
+
+#ifndef BondAnalytics_HPP
+#define BondAnalytics_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include "boost/date_time/gregorian/gregorian.hpp"
+#include "soa.hpp"
+#include "products.hpp"
+#include "priceTicks.hpp"
+#include "productRegistry.hpp"
+
+/**
+ * Risk of a bond at one clean price, per 100 face.
+ * PV01 and gamma are in price points, for a 1bp move in yield: the price moves
+ * by -pv01 * bp + 0.5 * gamma * bp^2. Yield is semi-annual, as a decimal.
+ */
+struct BondRisk
+{
+    double price = 0.;
+    double dirty_price = 0.;
+    double yield = 0.;
+    double pv01 = 0.;
+    double modified_duration = 0.;
+    double convexity = 0.;
+    double gamma = 0.;
+};
+
+// Year fraction between two dates under a day count convention
+// 30/360 follows the US bond basis
+double YearFraction(DayCountConvention convention, const boost::gregorian::date& start, const boost::gregorian::date& end) {
+    switch (convention) {
+    case THIRTY_THREE_SIXTY: {
+        int start_day = start.day();
+        int end_day = end.day();
+        if (start_day == 31) start_day = 30;
+        if (end_day == 31 && start_day == 30) end_day = 30;
+        return (360. * (int(end.year()) - int(start.year())) + 30. * (int(end.month()) - int(start.month()))
+            + (end_day - start_day)) / 360.;
+    }
+    case ACT_THREE_SIXTY:
+        return double((end - start).days()) / 360.;
+    }
+    throw std::invalid_argument("YearFraction: unknown day count convention");
+}
+
+/**
+ * Analytics of fixed coupon bonds paying semi-annually, from their coupon and maturity.
+ * A clean price is solved for its yield, then PV01, duration and convexity follow
+ * from the same discounting pass. Accrued interest and the fraction of the first
+ * period use the day count convention of the analytics.
+ * Results are cached per (product, price tick): a price ticks around a narrow range,
+ * so after warming up a price move is a hash lookup. A miss solves from the last
+ * yield of the product, which is a tick or two away, so Newton settles in a couple
+ * of steps.
+ * Thread-safe across products, a product is priced from one thread at a time.
+ * Type T is the product type.
+ */
+template<typename T>
+class BondAnalytics
+{
+
+public:
+
+    // ctor for analytics as of a settlement date
+    BondAnalytics(boost::gregorian::date _settlement, DayCountConvention _dayCount = THIRTY_THREE_SIXTY);
+
+    // Get the risk of a product at a clean price, solved once per price tick
+    // Throws invalid_argument for a non-positive price or a bond matured by settlement
+    const BondRisk& GetRisk(ProductHandle product, Ticks256 price);
+
+    // Solve the risk of a product at a clean price, bypassing the cache
+    BondRisk ComputeRisk(ProductHandle product, Ticks256 price);
+
+    // Get the clean price of a product with its cash flows discounted by discount(years)
+    template<typename Discount>
+    double ComputePrice(ProductHandle product, Discount discount);
+
+    // Get the settlement date risk is computed as of
+    const boost::gregorian::date& GetSettlementDate() const;
+
+    // Get the day count convention
+    DayCountConvention GetDayCountConvention() const;
+
+private:
+    static const int kMaxIterations = 50;
+
+    // Remaining cash flows of a product, laid out once, and its solved prices
+    struct Schedule
+    {
+        bool is_ready = false;
+        double coupon = 0.;          // Per period, per 100 face
+        std::size_t periods = 0;     // Coupons left
+        double first_period = 0.;    // Fraction of a period to the next coupon
+        double accrued = 0.;
+        double last_yield = 0.;
+        std::unordered_map<long, BondRisk> risks;  // Keyed on price tick
+    };
+
+    // Get the schedule of a product, laying it out on first use
+    Schedule& GetSchedule(ProductHandle product);
+
+    // Solve a clean price for its yield from a first guess, then risk it
+    static BondRisk Solve(const Schedule& schedule, double price, double yield);
+
+    boost::gregorian::date settlement_;
+    DayCountConvention day_count_;
+    ProductTable<Schedule> schedules_;
+
+};
+
+template<typename T>
+BondAnalytics<T>::BondAnalytics(boost::gregorian::date _settlement, DayCountConvention _dayCount) :
+  settlement_(_settlement), day_count_(_dayCount) {}
+
+template<typename T>
+const BondRisk& BondAnalytics<T>::GetRisk(ProductHandle product, Ticks256 price) {
+    Schedule& schedule = this->GetSchedule(product);
+    auto found = schedule.risks.find(price.GetTicks());
+    if (found != schedule.risks.end()) return found->second;
+
+    BondRisk risk = Solve(schedule, price.ToDouble(), schedule.last_yield);
+    schedule.last_yield = risk.yield;
+    return schedule.risks.emplace(price.GetTicks(), risk).first->second;
+}
+
+template<typename T>
+BondRisk BondAnalytics<T>::ComputeRisk(ProductHandle product, Ticks256 price) {
+    Schedule& schedule = this->GetSchedule(product);
+    return Solve(schedule, price.ToDouble(), schedule.last_yield);
+}
+
+template<typename T>
+template<typename Discount>
+double BondAnalytics<T>::ComputePrice(ProductHandle product, Discount discount) {
+    const Schedule& schedule = this->GetSchedule(product);
+    double value = 0.;
+    for (std::size_t k = 0; k < schedule.periods; k++) {
+        double cash_flow = schedule.coupon + ((k + 1 == schedule.periods) ? 100. : 0.);
+        value += cash_flow * discount((double(k) + schedule.first_period) / 2.);
+    }
+    return value - schedule.accrued;
+}
+
+template<typename T>
+const boost::gregorian::date& BondAnalytics<T>::GetSettlementDate() const {
+    return this->settlement_;
+}
+
+template<typename T>
+DayCountConvention BondAnalytics<T>::GetDayCountConvention() const {
+    return this->day_count_;
+}
+
+template<typename T>
+typename BondAnalytics<T>::Schedule& BondAnalytics<T>::GetSchedule(ProductHandle product) {
+    Schedule& schedule = this->schedules_[product];
+    if (schedule.is_ready) return schedule;
+
+    const T& bond = ProductRegistry<T>::Instance().Get(product);
+    boost::gregorian::date maturity = bond.GetMaturityDate();
+    if (maturity <= this->settlement_) {
+        throw std::invalid_argument("BondAnalytics: " + bond.GetProductId() + " has matured");
+    }
+
+    // Coupons fall every six months back from maturity, end of month dates stay end of month
+    std::size_t periods = 1;
+    while (maturity - boost::gregorian::months(6 * int(periods)) > this->settlement_) periods++;
+    boost::gregorian::date previous = maturity - boost::gregorian::months(6 * int(periods));
+    boost::gregorian::date next = maturity - boost::gregorian::months(6 * int(periods - 1));
+    double period = YearFraction(this->day_count_, previous, next);
+
+    schedule.coupon = bond.GetCoupon() / 2.;
+    schedule.periods = periods;
+    schedule.first_period = YearFraction(this->day_count_, this->settlement_, next) / period;
+    schedule.accrued = schedule.coupon * YearFraction(this->day_count_, previous, this->settlement_) / period;
+    schedule.last_yield = bond.GetCoupon() / 100.;
+    schedule.is_ready = true;
+    return schedule;
+}
+
+template<typename T>
+BondRisk BondAnalytics<T>::Solve(const Schedule& schedule, double price, double yield) {
+    if (!(price > 0.)) {
+        throw std::invalid_argument("BondAnalytics: price must be positive");
+    }
+    double dirty_price = price + schedule.accrued;
+
+    // Discount at the yield, with the first and second derivatives in the same pass
+    double value = 0., slope = 0., curvature = 0.;
+    bool is_solved = false;
+    for (int i = 0; i < kMaxIterations && !is_solved; i++) {
+        double discount = 1. / (1. + yield / 2.);
+        double factor = std::pow(discount, schedule.first_period);
+        double moment = 0., second_moment = 0.;
+        value = 0.;
+        for (std::size_t k = 0; k < schedule.periods; k++) {
+            double cash_flow = schedule.coupon + ((k + 1 == schedule.periods) ? 100. : 0.);
+            double time = double(k) + schedule.first_period;
+            double present_value = cash_flow * factor;
+            value += present_value;
+            moment += time * present_value;
+            second_moment += time * (time + 1.) * present_value;
+            factor *= discount;
+        }
+        slope = -0.5 * discount * moment;
+        curvature = 0.25 * discount * discount * second_moment;
+
+        double step = (value - dirty_price) / slope;
+        yield -= step;
+        is_solved = std::fabs(step) < 1e-12;
+    }
+    if (!is_solved) {
+        throw std::runtime_error("BondAnalytics: yield did not converge");
+    }
+
+    BondRisk risk;
+    risk.price = price;
+    risk.dirty_price = value;
+    risk.yield = yield;
+    risk.modified_duration = -slope / value;
+    risk.convexity = curvature / value;
+    risk.pv01 = -slope * 1e-4;
+    risk.gamma = curvature * 1e-8;
+    return risk;
+}
+
+#endif
@@ -0,0 +1,135 @@
+
+#ifndef BookRegistry_HPP
+#define BookRegistry_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Compact handle to an interned book, dense from 0 in registration order
+typedef unsigned BookHandle;
+
+const BookHandle kInvalidBookHandle = std::numeric_limits<BookHandle>::max();
+
+/**
+ * Registry interning each trading book exactly once for the whole process.
+ * Trades carry a BookHandle instead of a copy of the book name, and positions
+ * index their books on it. A desk trades into a handful of books, so the first
+ * kInlineBooks get fixed slots, few enough for a Position to fit a cache line, and
+ * a name is found with a scan of the registered ones. Any further book goes to an
+ * overflow list, so a larger desk still books every trade, only slower.
+ * Lookups of inline books are lock-free, registering and looking up overflow books
+ * take a lock, so parser threads may intern concurrently.
+ */
+class BookRegistry
+{
+
+public:
+
+    static const std::size_t kInlineBooks = 5;
+
+    // Get the registry shared by every service
+    static BookRegistry& Instance();
+
+    // Intern a book name, returns the existing handle if it is already registered
+    BookHandle Intern(std::string_view book);
+
+    // Find the handle of a book name, kInvalidBookHandle if unknown
+    BookHandle Find(std::string_view book) const;
+
+    // Get the name behind a handle
+    const std::string& Get(BookHandle handle) const;
+
+    // Get the number of registered books
+    std::size_t GetSize() const;
+
+private:
+    BookRegistry();
+
+    // Find a book past the inline ones, with intern_mutex_ held
+    BookHandle FindOverflow(std::string_view book) const;
+
+    // Names never move, a name is published by bumping the count after it is written
+    std::string books_[kInlineBooks];
+    std::deque<std::string> overflow_books_;
+    std::atomic<std::size_t> book_count_;
+    mutable std::mutex intern_mutex_;
+
+};
+
+BookRegistry::BookRegistry() : book_count_(0) {}
+
+BookRegistry& BookRegistry::Instance()
+{
+    static BookRegistry registry;
+    return registry;
+}
+
+BookHandle BookRegistry::Intern(std::string_view book)
+{
+    BookHandle handle = this->Find(book);
+    if (handle != kInvalidBookHandle) {
+        return handle;
+    }
+
+    std::lock_guard<std::mutex> lock(intern_mutex_);
+    std::size_t count = book_count_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < std::min(count, kInlineBooks); i++) {
+        if (books_[i] == book) return BookHandle(i);
+    }
+    handle = this->FindOverflow(book);
+    if (handle != kInvalidBookHandle) {
+        return handle;
+    }
+    if (count < kInlineBooks) {
+        books_[count] = std::string(book);
+    } else {
+        overflow_books_.emplace_back(book);
+    }
+    book_count_.store(count + 1, std::memory_order_release);
+    return BookHandle(count);
+}
+
+BookHandle BookRegistry::Find(std::string_view book) const
+{
+    std::size_t count = book_count_.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < std::min(count, kInlineBooks); i++) {
+        if (books_[i] == book) return BookHandle(i);
+    }
+    if (count <= kInlineBooks) {
+        return kInvalidBookHandle;
+    }
+    std::lock_guard<std::mutex> lock(intern_mutex_);
+    return this->FindOverflow(book);
+}
+
+BookHandle BookRegistry::FindOverflow(std::string_view book) const
+{
+    for (std::size_t i = 0; i < overflow_books_.size(); i++) {
+        if (overflow_books_[i] == book) return BookHandle(kInlineBooks + i);
+    }
+    return kInvalidBookHandle;
+}
+
+const std::string& BookRegistry::Get(BookHandle handle) const
+{
+    if (handle < kInlineBooks) {
+        return books_[handle];
+    }
+    // A deque never moves its elements, the reference outlives the lock
+    std::lock_guard<std::mutex> lock(intern_mutex_);
+    return overflow_books_.at(handle - kInlineBooks);
+}
+
+std::size_t BookRegistry::GetSize() const
+{
+    return book_count_.load(std::memory_order_acquire);
+}
+
+#endif
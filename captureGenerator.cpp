@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "mappedFile.hpp"
+
+/**
+ * Deterministic generator of timestamped captures for the replay driver.
+ * Usage: tradingsystem_capture [session seconds (60)] [seed (1)]
+ * Each of prices.txt, trades.txt, marketdata.txt and inquiries.txt found in the
+ * working directory becomes a .capture file next to it. The records of every feed
+ * are spread over the same session at random, keeping their order, so the feeds
+ * interleave the way they would on a trading day.
+ * The same seed always produces the same captures.
+ */
+
+// Session start, 2024-01-02 14:30:00 UTC in nanoseconds since the epoch
+const std::int64_t kSessionStart = 1704205800000000000;
+
+// Stamp the lines of one input file, returns the number of records written
+std::size_t StampFile(const std::string& input, const std::string& output, std::int64_t session, std::mt19937_64& generator) {
+    MappedFile data(input);
+    if (!data.IsOpen()) return 0;
+
+    std::vector<std::string_view> lines;
+    LineReader reader(data.GetView());
+    std::string_view line;
+    while (reader.Next(line)) {
+        if (!line.empty()) lines.push_back(line);
+    }
+
+    // Sorted uniform arrival times keep the file order
+    std::uniform_int_distribution<std::int64_t> arrival(0, session - 1);
+    std::vector<std::int64_t> timestamps(lines.size());
+    for (auto& timestamp : timestamps) timestamp = kSessionStart + arrival(generator);
+    std::sort(timestamps.begin(), timestamps.end());
+
+    std::ofstream file(output, std::ios::trunc);
+    for (std::size_t i = 0; i < lines.size(); i++) {
+        file << timestamps[i] << ',' << lines[i] << '\n';
+    }
+    return lines.size();
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = (argc > 1) ? std::strtod(argv[1], nullptr) : 60.;
+    std::uint64_t seed = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 1;
+    std::int64_t session = std::max<std::int64_t>(1, std::int64_t(seconds * 1e9));
+
+    std::mt19937_64 generator(seed);
+    for (std::string feed : { "prices", "trades", "marketdata", "inquiries" }) {
+        std::size_t count = StampFile(feed + ".txt", feed + ".capture", session, generator);
+        std::cout << "Captured " << count << " records into " << feed << ".capture" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,509 @@
+
+#ifndef ColumnarStore_HPP
+#define ColumnarStore_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/stat.h>
+#include "lzBlock.hpp"
+#include "mappedFile.hpp"
+#include "recordWriter.hpp"
+
+/**
+ * Binary column-oriented append-only store.
+ * File: a header naming the columns, then a run of blocks.
+ *   header: "TSCOLUMN", uint32 column count, then per column
+ *           uint32 type, uint32 width, uint32 name length, name bytes
+ *   block:  BlockHeader, per column uint32 raw size and uint32 stored size,
+ *           then each column's values back to back
+ * Every column holds fixed-width values, column 0 is always the int64 timestamp
+ * (nanoseconds since epoch) the row was written at. A column whose stored size is
+ * below its raw size is LZ compressed. Values are in host byte order.
+ */
+
+enum ColumnType { INT8_COLUMN, INT64_COLUMN, FLOAT64_COLUMN, TEXT_COLUMN };
+
+/**
+ * Name, type and width in bytes of a column.
+ * Text columns are padded with '\0' to their width and truncated past it.
+ */
+struct ColumnSpec
+{
+    ColumnSpec() = default;
+    // ctor for a column, the width is only needed for text columns
+    ColumnSpec(std::string _name, ColumnType _type, std::uint32_t _width = 0);
+
+    std::string name;
+    ColumnType type = INT64_COLUMN;
+    std::uint32_t width = 8;
+};
+
+/**
+ * Fixed-size header leading every block.
+ * A reader can skip a whole block on its timestamp range without touching the data.
+ */
+struct BlockHeader
+{
+    std::uint32_t magic = 0;
+    std::uint32_t row_count = 0;
+    std::int64_t min_timestamp = 0;
+    std::int64_t max_timestamp = 0;
+    std::uint32_t column_count = 0;
+    std::uint32_t flags = 0;
+};
+
+const char kColumnarMagic[8] = { 'T', 'S', 'C', 'O', 'L', 'U', 'M', 'N' };
+const std::uint32_t kBlockMagic = 0x314B4C42;
+const std::uint32_t kBlockCompressed = 1;
+
+/**
+ * Writer appending rows to a columnar file.
+ * Rows accumulate column by column in memory and are sealed into a block once
+ * rows_per_block of them are buffered. Sealed blocks go through a RecordWriter,
+ * so the durability policy is the same as for the text store.
+ * Appending to a non-empty file adds blocks under its existing header, which must
+ * carry the same columns.
+ */
+class ColumnarWriter
+{
+
+public:
+
+    // ctor for a writer, the timestamp column is added in front of the given columns
+    ColumnarWriter(const std::string& path, const std::vector<ColumnSpec>& columns, bool compress = false,
+        std::size_t rows_per_block = 4096, WriterPolicy policy = WriterPolicy());
+    ~ColumnarWriter();
+
+    ColumnarWriter(const ColumnarWriter&) = delete;
+    ColumnarWriter& operator = (const ColumnarWriter&) = delete;
+
+    // Start a row, every column is zero until it is set
+    void BeginRow(std::int64_t timestamp);
+
+    // Set an int8 or int64 column of the current row
+    void SetInt(std::size_t column, std::int64_t value);
+
+    // Set a float64 column of the current row
+    void SetDouble(std::size_t column, double value);
+
+    // Set a text column of the current row
+    void SetText(std::size_t column, std::string_view value);
+
+    // Finish the current row, sealing the block if it is full
+    void EndRow();
+
+    // Seal the buffered rows into a block and write it out
+    void Flush();
+
+    // Get the columns, timestamp included
+    const std::vector<ColumnSpec>& GetColumns() const;
+
+private:
+    // Encode the buffered rows as one block and hand it to the writer
+    void SealBlock();
+
+    // Get the slot of a column in the current row
+    char* GetCell(std::size_t column);
+
+    std::vector<ColumnSpec> columns_;
+    std::vector<std::string> buffers_;
+    std::size_t row_count_;
+    std::size_t rows_per_block_;
+    bool compress_;
+    std::int64_t min_timestamp_;
+    std::int64_t max_timestamp_;
+    std::string block_;
+    std::string compressed_;
+    RecordWriter writer_;
+
+};
+
+/**
+ * Reader over a columnar file.
+ * Block headers are indexed when the file is opened. A scan decodes only the
+ * requested column of the blocks overlapping the requested time range, every
+ * other column is skipped by its stored size.
+ */
+class ColumnarReader
+{
+
+public:
+
+    // ctor mapping and indexing the file at the given path
+    ColumnarReader(const std::string& path);
+
+    // Whether the file has been mapped and its header parsed
+    bool IsOpen() const;
+
+    // Get the columns, timestamp included
+    const std::vector<ColumnSpec>& GetColumns() const;
+
+    // Get the index of a column from its name
+    std::size_t FindColumn(std::string_view name) const;
+
+    // Get the number of rows across every block
+    std::size_t GetRowCount() const;
+
+    // Get the number of blocks
+    std::size_t GetBlockCount() const;
+
+    // Visit the raw values of one column block by block as visit(header, values, row_count)
+    template<typename Visitor>
+    void ScanColumn(std::size_t column, Visitor visit,
+        std::int64_t from = std::numeric_limits<std::int64_t>::min(),
+        std::int64_t to = std::numeric_limits<std::int64_t>::max()) const;
+
+    // Read an int8 or int64 column
+    std::vector<std::int64_t> ReadIntColumn(std::string_view name,
+        std::int64_t from = std::numeric_limits<std::int64_t>::min(),
+        std::int64_t to = std::numeric_limits<std::int64_t>::max()) const;
+
+    // Read a float64 column
+    std::vector<double> ReadDoubleColumn(std::string_view name,
+        std::int64_t from = std::numeric_limits<std::int64_t>::min(),
+        std::int64_t to = std::numeric_limits<std::int64_t>::max()) const;
+
+    // Read a text column, padding stripped
+    std::vector<std::string> ReadTextColumn(std::string_view name,
+        std::int64_t from = std::numeric_limits<std::int64_t>::min(),
+        std::int64_t to = std::numeric_limits<std::int64_t>::max()) const;
+
+private:
+    struct BlockIndex
+    {
+        BlockHeader header;
+        // Offset of each column's stored values, plus the end of the block
+        std::vector<std::size_t> offsets;
+        std::vector<std::uint32_t> raw_sizes;
+    };
+
+    // Parse the file header and index every block, returns false on a malformed file
+    bool Index();
+
+    MappedFile file_;
+    std::vector<ColumnSpec> columns_;
+    std::vector<BlockIndex> blocks_;
+    bool is_open_;
+    mutable std::string scratch_;
+
+};
+
+// Read a fixed-width value at an arbitrary offset of a block
+template<typename V>
+V LoadValue(const char* data)
+{
+    V value;
+    std::memcpy(&value, data, sizeof(V));
+    return value;
+}
+
+// Append a fixed-width value to a buffer
+template<typename V>
+void StoreValue(std::string& out, V value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(V));
+}
+
+ColumnSpec::ColumnSpec(std::string _name, ColumnType _type, std::uint32_t _width) : name(_name), type(_type)
+{
+    switch (type)
+    {
+    case INT8_COLUMN:
+        width = 1;
+        break;
+    case INT64_COLUMN:
+    case FLOAT64_COLUMN:
+        width = 8;
+        break;
+    case TEXT_COLUMN:
+        width = _width;
+        break;
+    }
+}
+
+ColumnarWriter::ColumnarWriter(const std::string& path, const std::vector<ColumnSpec>& columns, bool compress,
+    std::size_t rows_per_block, WriterPolicy policy) :
+    row_count_(0), rows_per_block_(rows_per_block), compress_(compress),
+    min_timestamp_(0), max_timestamp_(0), writer_(path, policy)
+{
+    columns_.push_back(ColumnSpec("timestamp", INT64_COLUMN));
+    columns_.insert(columns_.end(), columns.begin(), columns.end());
+    buffers_.resize(columns_.size());
+    for (std::size_t i = 0; i < columns_.size(); i++) {
+        buffers_[i].reserve(columns_[i].width * rows_per_block_);
+    }
+
+    // A fresh file gets its header, an existing one is appended to
+    struct stat file_stat;
+    if (::stat(path.c_str(), &file_stat) == 0 && file_stat.st_size > 0) return;
+
+    std::string header(kColumnarMagic, sizeof(kColumnarMagic));
+    StoreValue<std::uint32_t>(header, std::uint32_t(columns_.size()));
+    for (const auto& column : columns_) {
+        StoreValue<std::uint32_t>(header, std::uint32_t(column.type));
+        StoreValue<std::uint32_t>(header, column.width);
+        StoreValue<std::uint32_t>(header, std::uint32_t(column.name.size()));
+        header.append(column.name);
+    }
+    writer_.Append(header);
+}
+
+ColumnarWriter::~ColumnarWriter()
+{
+    this->SealBlock();
+}
+
+void ColumnarWriter::BeginRow(std::int64_t timestamp)
+{
+    for (std::size_t i = 0; i < columns_.size(); i++) {
+        buffers_[i].append(columns_[i].width, '\0');
+    }
+    std::memcpy(this->GetCell(0), &timestamp, sizeof(timestamp));
+
+    if (row_count_ == 0 || timestamp < min_timestamp_) min_timestamp_ = timestamp;
+    if (row_count_ == 0 || timestamp > max_timestamp_) max_timestamp_ = timestamp;
+}
+
+void ColumnarWriter::SetInt(std::size_t column, std::int64_t value)
+{
+    if (columns_[column].type == INT8_COLUMN) {
+        std::int8_t narrow = std::int8_t(value);
+        std::memcpy(this->GetCell(column), &narrow, sizeof(narrow));
+    } else {
+        std::memcpy(this->GetCell(column), &value, sizeof(value));
+    }
+}
+
+void ColumnarWriter::SetDouble(std::size_t column, double value)
+{
+    std::memcpy(this->GetCell(column), &value, sizeof(value));
+}
+
+void ColumnarWriter::SetText(std::size_t column, std::string_view value)
+{
+    std::size_t width = columns_[column].width;
+    std::memcpy(this->GetCell(column), value.data(), value.size() < width ? value.size() : width);
+}
+
+void ColumnarWriter::EndRow()
+{
+    if (++row_count_ >= rows_per_block_) {
+        this->SealBlock();
+    }
+}
+
+void ColumnarWriter::Flush()
+{
+    this->SealBlock();
+    writer_.Flush();
+}
+
+const std::vector<ColumnSpec>& ColumnarWriter::GetColumns() const
+{
+    return this->columns_;
+}
+
+char* ColumnarWriter::GetCell(std::size_t column)
+{
+    std::string& buffer = buffers_[column];
+    return &buffer[buffer.size() - columns_[column].width];
+}
+
+void ColumnarWriter::SealBlock()
+{
+    if (row_count_ == 0) return;
+
+    BlockHeader header;
+    header.magic = kBlockMagic;
+    header.row_count = std::uint32_t(row_count_);
+    header.min_timestamp = min_timestamp_;
+    header.max_timestamp = max_timestamp_;
+    header.column_count = std::uint32_t(columns_.size());
+    header.flags = compress_ ? kBlockCompressed : 0;
+
+    block_.clear();
+    compressed_.clear();
+    block_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Sizes first, so that a reader can skip columns without decoding them
+    std::vector<std::size_t> stored_offsets(columns_.size(), 0);
+    for (std::size_t i = 0; i < columns_.size(); i++) {
+        const std::string& raw = buffers_[i];
+        std::size_t stored_size = raw.size();
+        if (compress_) {
+            std::size_t offset = compressed_.size();
+            std::size_t compressed_size = LzCompress(raw.data(), raw.size(), compressed_);
+            if (compressed_size < raw.size()) {
+                stored_offsets[i] = offset;
+                stored_size = compressed_size;
+            } else {
+                compressed_.resize(offset);
+            }
+        }
+        StoreValue<std::uint32_t>(block_, std::uint32_t(raw.size()));
+        StoreValue<std::uint32_t>(block_, std::uint32_t(stored_size));
+        stored_offsets.push_back(stored_size);
+    }
+
+    for (std::size_t i = 0; i < columns_.size(); i++) {
+        std::size_t stored_size = stored_offsets[columns_.size() + i];
+        if (stored_size < buffers_[i].size()) {
+            block_.append(compressed_, stored_offsets[i], stored_size);
+        } else {
+            block_.append(buffers_[i]);
+        }
+        buffers_[i].clear();
+    }
+
+    writer_.Append(block_);
+    row_count_ = 0;
+}
+
+ColumnarReader::ColumnarReader(const std::string& path) : file_(path), is_open_(false)
+{
+    is_open_ = file_.IsOpen() && this->Index();
+}
+
+bool ColumnarReader::IsOpen() const
+{
+    return this->is_open_;
+}
+
+const std::vector<ColumnSpec>& ColumnarReader::GetColumns() const
+{
+    return this->columns_;
+}
+
+std::size_t ColumnarReader::FindColumn(std::string_view name) const
+{
+    for (std::size_t i = 0; i < columns_.size(); i++) {
+        if (columns_[i].name == name) return i;
+    }
+    throw std::invalid_argument("ColumnarReader: unknown column '" + std::string(name) + "'");
+}
+
+std::size_t ColumnarReader::GetRowCount() const
+{
+    std::size_t rows = 0;
+    for (const auto& block : blocks_) {
+        rows += block.header.row_count;
+    }
+    return rows;
+}
+
+std::size_t ColumnarReader::GetBlockCount() const
+{
+    return this->blocks_.size();
+}
+
+bool ColumnarReader::Index()
+{
+    std::string_view data = file_.GetView();
+    std::size_t pos = sizeof(kColumnarMagic) + sizeof(std::uint32_t);
+    if (data.size() < pos || std::memcmp(data.data(), kColumnarMagic, sizeof(kColumnarMagic)) != 0) return false;
+
+    std::uint32_t column_count = LoadValue<std::uint32_t>(data.data() + sizeof(kColumnarMagic));
+    for (std::uint32_t i = 0; i < column_count; i++) {
+        if (data.size() - pos < 3 * sizeof(std::uint32_t)) return false;
+        ColumnSpec column;
+        column.type = ColumnType(LoadValue<std::uint32_t>(data.data() + pos));
+        column.width = LoadValue<std::uint32_t>(data.data() + pos + 4);
+        std::uint32_t name_length = LoadValue<std::uint32_t>(data.data() + pos + 8);
+        pos += 3 * sizeof(std::uint32_t);
+        if (data.size() - pos < name_length) return false;
+        column.name = std::string(data.substr(pos, name_length));
+        pos += name_length;
+        columns_.push_back(column);
+    }
+
+    while (pos < data.size()) {
+        BlockIndex block;
+        std::size_t sizes_length = columns_.size() * 2 * sizeof(std::uint32_t);
+        if (data.size() - pos < sizeof(BlockHeader) + sizes_length) return false;
+        std::memcpy(&block.header, data.data() + pos, sizeof(BlockHeader));
+        if (block.header.magic != kBlockMagic || block.header.column_count != columns_.size()) return false;
+        pos += sizeof(BlockHeader);
+
+        std::size_t offset = pos + sizes_length;
+        for (std::size_t i = 0; i < columns_.size(); i++) {
+            block.raw_sizes.push_back(LoadValue<std::uint32_t>(data.data() + pos));
+            block.offsets.push_back(offset);
+            offset += LoadValue<std::uint32_t>(data.data() + pos + 4);
+            pos += 2 * sizeof(std::uint32_t);
+        }
+        if (offset > data.size()) return false;
+        block.offsets.push_back(offset);
+
+        blocks_.push_back(block);
+        pos = offset;
+    }
+    return true;
+}
+
+template<typename Visitor>
+void ColumnarReader::ScanColumn(std::size_t column, Visitor visit, std::int64_t from, std::int64_t to) const
+{
+    const char* data = file_.GetView().data();
+    for (const auto& block : blocks_) {
+        if (block.header.max_timestamp < from || block.header.min_timestamp > to) continue;
+
+        std::size_t stored_size = block.offsets[column + 1] - block.offsets[column];
+        std::size_t raw_size = block.raw_sizes[column];
+        const char* values = data + block.offsets[column];
+        if (stored_size < raw_size) {
+            scratch_.resize(raw_size);
+            if (!LzDecompress(values, stored_size, &scratch_[0], raw_size)) {
+                throw std::runtime_error("ColumnarReader: corrupt block in column '" + columns_[column].name + "'");
+            }
+            values = scratch_.data();
+        }
+        visit(block.header, values, std::size_t(block.header.row_count));
+    }
+}
+
+std::vector<std::int64_t> ColumnarReader::ReadIntColumn(std::string_view name, std::int64_t from, std::int64_t to) const
+{
+    std::size_t column = this->FindColumn(name);
+    bool is_narrow = (columns_[column].type == INT8_COLUMN);
+    std::vector<std::int64_t> values;
+    this->ScanColumn(column, [&](const BlockHeader&, const char* cells, std::size_t rows) {
+        for (std::size_t i = 0; i < rows; i++) {
+            values.push_back(is_narrow ? LoadValue<std::int8_t>(cells + i) : LoadValue<std::int64_t>(cells + 8 * i));
+        }
+    }, from, to);
+    return values;
+}
+
+std::vector<double> ColumnarReader::ReadDoubleColumn(std::string_view name, std::int64_t from, std::int64_t to) const
+{
+    std::size_t column = this->FindColumn(name);
+    std::vector<double> values;
+    this->ScanColumn(column, [&](const BlockHeader&, const char* cells, std::size_t rows) {
+        for (std::size_t i = 0; i < rows; i++) {
+            values.push_back(LoadValue<double>(cells + 8 * i));
+        }
+    }, from, to);
+    return values;
+}
+
+std::vector<std::string> ColumnarReader::ReadTextColumn(std::string_view name, std::int64_t from, std::int64_t to) const
+{
+    std::size_t column = this->FindColumn(name);
+    std::size_t width = columns_[column].width;
+    std::vector<std::string> values;
+    this->ScanColumn(column, [&](const BlockHeader&, const char* cells, std::size_t rows) {
+        for (std::size_t i = 0; i < rows; i++) {
+            const char* cell = cells + width * i;
+            values.emplace_back(cell, strnlen(cell, width));
+        }
+    }, from, to);
+    return values;
+}
+
+#endif
@@ -0,0 +1,448 @@
+
+#ifndef CurveService_HPP
+#define CurveService_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "soa.hpp"
+#include "pricingService.hpp"
+#include "bondAnalytics.hpp"
+#include "utilities.hpp"
+
+// Second derivatives of the natural cubic spline through (tenors, values)
+std::vector<double> SolveNaturalSpline(const std::vector<double>& tenors, const std::vector<double>& values) {
+    std::size_t n = tenors.size();
+    std::vector<double> curvatures(n, 0.);
+    if (n < 3) return curvatures;
+
+    // Tridiagonal system on the interior knots, the ends are flat (natural)
+    std::vector<double> diagonal(n, 0.), rhs(n, 0.);
+    for (std::size_t i = 1; i + 1 < n; i++) {
+        double left = tenors[i] - tenors[i - 1];
+        double right = tenors[i + 1] - tenors[i];
+        diagonal[i] = 2. * (left + right);
+        rhs[i] = 6. * ((values[i + 1] - values[i]) / right - (values[i] - values[i - 1]) / left);
+    }
+    for (std::size_t i = 2; i + 1 < n; i++) {
+        double left = tenors[i] - tenors[i - 1];
+        double factor = left / diagonal[i - 1];
+        diagonal[i] -= factor * left;
+        rhs[i] -= factor * rhs[i - 1];
+    }
+    for (std::size_t i = n - 2; i >= 1; i--) {
+        double right = tenors[i + 1] - tenors[i];
+        curvatures[i] = (rhs[i] - right * curvatures[i + 1]) / diagonal[i];
+    }
+    return curvatures;
+}
+
+// Value of a cubic spline at a tenor, flat past either end
+double EvaluateSpline(const std::vector<double>& tenors, const std::vector<double>& values,
+    const std::vector<double>& curvatures, double tenor) {
+    if (tenor <= tenors.front()) return values.front();
+    if (tenor >= tenors.back()) return values.back();
+
+    std::size_t i = 1;
+    while (tenors[i] < tenor) i++;
+    double h = tenors[i] - tenors[i - 1];
+    double a = (tenors[i] - tenor) / h;
+    double b = 1. - a;
+    return a * values[i - 1] + b * values[i]
+        + ((a * a * a - a) * curvatures[i - 1] + (b * b * b - b) * curvatures[i]) * h * h / 6.;
+}
+
+/**
+ * Snapshot of a yield curve.
+ * Par yields at the benchmark tenors are joined by a natural cubic spline, and the
+ * zero curve is bootstrapped from it on a semi-annual grid of par bonds. Discount
+ * factors are log-linear between grid nodes, rates are semi-annual decimals and
+ * tenors are in years. A snapshot never changes once published.
+ * Type T is the product type.
+ */
+template<typename T>
+class YieldCurve
+{
+
+public:
+
+    YieldCurve() = default;
+    // ctor for a curve snapshot
+    YieldCurve(std::string _name, std::uint64_t _version, std::vector<double> _tenors, std::vector<double> _parYields,
+        std::vector<double> _curvatures, std::vector<double> _discountFactors);
+
+    // Get the name of the curve
+    const std::string& GetName() const;
+
+    // Get the number of rebuilds this snapshot follows
+    std::uint64_t GetVersion() const;
+
+    // Get the benchmark tenors and their par yields
+    const std::vector<double>& GetTenors() const;
+    const std::vector<double>& GetParYields() const;
+
+    // Get the par yield at a tenor, from the spline
+    double GetParYield(double tenor) const;
+
+    // Get the discount factor to a tenor
+    double GetDiscountFactor(double tenor) const;
+
+    // Get the zero rate to a tenor
+    double GetZeroRate(double tenor) const;
+
+    std::vector<std::string> ToString() const;
+
+private:
+    std::string name;
+    std::uint64_t version = 0;
+    std::vector<double> tenors;
+    std::vector<double> parYields;
+    std::vector<double> curvatures;
+    std::vector<double> discountFactors;  // Grid node i at (i + 1) / 2 years
+
+};
+
+template<typename T>
+class PricingToCurveListener;
+
+/**
+ * Curve Service to build a yield curve from the mids of the benchmark bonds.
+ * Keyed on curve name.
+ * Each mid is solved for its par yield by the bond analytics, then the curve is
+ * rebuilt incrementally: the spline is linear in the par yields, so the weight of
+ * each benchmark on every spline second derivative and grid node is laid out once,
+ * and a moving benchmark adds its own column. The bootstrap restarts at the first
+ * grid node that moved. A mid that leaves its yield unchanged publishes nothing.
+ * Snapshots go to listeners once every benchmark has a price, and GetCurve() hands
+ * the latest out to any thread.
+ * Type T is the product type.
+ */
+template<typename T>
+class CurveService : public Service<string, YieldCurve<T>>
+{
+
+public:
+
+    // ctor for a curve through the benchmarks, risked as of a settlement date
+    CurveService(std::string name, const std::vector<T>& benchmarks, boost::gregorian::date settlement = kSettlementDate);
+    ~CurveService();
+
+    // Get data on our service given a key (curve name)
+    virtual YieldCurve<T>& GetData(std::string name) override;
+
+    // The callback that a Connector should invoke for any new or updated data
+    virtual void OnMessage(YieldCurve<T>& data) override;
+
+    // Add a listener to the Service for callbacks on add, remove, and update events
+    // for data to the Service.
+    virtual void AddListener(ServiceListener<YieldCurve<T>>* listener) override;
+
+    // Get all listeners on the Service.
+    virtual const vector<ServiceListener<YieldCurve<T>>*>& GetListeners() const override;
+
+    PricingToCurveListener<T>* GetInListener();
+
+    // Move a benchmark to a new mid, prices of other products are ignored
+    void AddPrice(const Price<T>& price);
+
+    // Get the latest curve, null until every benchmark has a price
+    std::shared_ptr<const YieldCurve<T>> GetCurve() const;
+
+    // Get the clean price of a product discounted on the latest curve
+    // Throws out_of_range before the curve is built
+    double GetFairPrice(ProductHandle product);
+
+private:
+    // Move benchmark point to a par yield and republish, with the lock held
+    void Rebuild(std::size_t point, double par_yield);
+
+    std::string name_;
+    BondAnalytics<T> analytics_;
+    ProductTable<std::size_t> points_;  // Benchmark index of a product
+
+    std::vector<double> tenors_;
+    std::vector<double> par_yields_;
+    std::vector<bool> is_priced_;
+    std::size_t priced_count_ = 0;
+    std::vector<std::vector<double>> curvature_weights_;  // Per benchmark, then per knot
+    std::vector<std::vector<double>> node_weights_;       // Per benchmark, then per grid node
+    std::vector<double> curvatures_;
+    std::vector<double> node_par_yields_;
+    std::vector<double> discount_factors_;
+    std::vector<double> annuities_;  // Running sum of the discount factors
+    std::uint64_t version_ = 0;
+
+    std::mutex build_mutex_;
+    std::shared_ptr<YieldCurve<T>> curve_;
+    PricingToCurveListener<T>* in_listener_;
+
+};
+
+template<typename T>
+class PricingToCurveListener final : public ServiceListener<Price<T>> {
+private:
+    CurveService<T>* service_;
+
+public:
+
+    PricingToCurveListener(CurveService<T>* _service);
+    ~PricingToCurveListener() = default;
+
+    // Listener callback to process an add event to the Service
+    virtual void ProcessAdd(Price<T> &data) override;
+
+    // Listener callback to process a remove event to the Service
+    virtual void ProcessRemove(Price<T> &data) override;
+
+    // Listener callback to process an update event to the Service
+    virtual void ProcessUpdate(Price<T> &data) override;
+
+};
+
+template<typename T>
+YieldCurve<T>::YieldCurve(std::string _name, std::uint64_t _version, std::vector<double> _tenors, std::vector<double> _parYields,
+    std::vector<double> _curvatures, std::vector<double> _discountFactors) :
+  name(std::move(_name)), version(_version), tenors(std::move(_tenors)), parYields(std::move(_parYields)),
+  curvatures(std::move(_curvatures)), discountFactors(std::move(_discountFactors)) {}
+
+template<typename T>
+const std::string& YieldCurve<T>::GetName() const {
+    return this->name;
+}
+
+template<typename T>
+std::uint64_t YieldCurve<T>::GetVersion() const {
+    return this->version;
+}
+
+template<typename T>
+const std::vector<double>& YieldCurve<T>::GetTenors() const {
+    return this->tenors;
+}
+
+template<typename T>
+const std::vector<double>& YieldCurve<T>::GetParYields() const {
+    return this->parYields;
+}
+
+template<typename T>
+double YieldCurve<T>::GetParYield(double tenor) const {
+    return EvaluateSpline(this->tenors, this->parYields, this->curvatures, tenor);
+}
+
+template<typename T>
+double YieldCurve<T>::GetDiscountFactor(double tenor) const {
+    if (tenor <= 0.) return 1.;
+
+    // Log-linear between nodes, from 1 at time 0, and on the last zero rate past the grid
+    double node = tenor * 2.;
+    std::size_t upper = std::size_t(std::ceil(node));
+    std::size_t count = this->discountFactors.size();
+    if (upper > count) {
+        double last = double(count) / 2.;
+        return std::pow(this->discountFactors.back(), tenor / last);
+    }
+    double lower_factor = (upper == 1) ? 1. : this->discountFactors[upper - 2];
+    double upper_factor = this->discountFactors[upper - 1];
+    double weight = node - double(upper - 1);
+    return lower_factor * std::pow(upper_factor / lower_factor, weight);
+}
+
+template<typename T>
+double YieldCurve<T>::GetZeroRate(double tenor) const {
+    // Inside the first node the rate is the first node's
+    tenor = std::max(tenor, 0.5);
+    return 2. * (std::pow(this->GetDiscountFactor(tenor), -1. / (2. * tenor)) - 1.);
+}
+
+template<typename T>
+std::vector<std::string> YieldCurve<T>::ToString() const {
+    std::vector<std::string> _strings;
+    _strings.push_back(this->name);
+    _strings.push_back(std::to_string(this->version));
+    for (std::size_t i = 0; i < this->tenors.size(); i++) {
+        _strings.push_back(std::to_string(this->tenors[i]));
+        _strings.push_back(std::to_string(this->parYields[i]));
+    }
+    return _strings;
+}
+
+std::vector<Bond> MakeTreasuryBenchmarks() {
+    std::vector<Bond> benchmarks;
+    for (const auto& [maturity, bond] : kBondMapMaturity) benchmarks.push_back(FetchBond(maturity));
+    return benchmarks;
+}
+
+template<typename T>
+CurveService<T>::CurveService(std::string name, const std::vector<T>& benchmarks, boost::gregorian::date settlement) :
+  name_(std::move(name)), analytics_(settlement) {
+    if (benchmarks.empty()) {
+        throw std::invalid_argument("CurveService: no benchmarks");
+    }
+    for (const T& bond : benchmarks) {
+        ProductHandle product = ProductRegistry<T>::Instance().Intern(bond);
+        double tenor = YearFraction(this->analytics_.GetDayCountConvention(), settlement, bond.GetMaturityDate());
+        if (!this->tenors_.empty() && tenor <= this->tenors_.back()) {
+            throw std::invalid_argument("CurveService: benchmarks must be in increasing maturity");
+        }
+        this->points_.InsertOrAssign(product, this->tenors_.size());
+        this->tenors_.push_back(tenor);
+    }
+
+    // The spline is linear in the par yields, lay out the weight of each benchmark once
+    std::size_t count = this->tenors_.size();
+    std::size_t node_count = std::size_t(std::ceil(this->tenors_.back() * 2.));
+    for (std::size_t point = 0; point < count; point++) {
+        std::vector<double> unit(count, 0.);
+        unit[point] = 1.;
+        std::vector<double> curvatures = SolveNaturalSpline(this->tenors_, unit);
+        std::vector<double> nodes(node_count);
+        for (std::size_t node = 0; node < node_count; node++) {
+            nodes[node] = EvaluateSpline(this->tenors_, unit, curvatures, double(node + 1) / 2.);
+        }
+        this->curvature_weights_.push_back(std::move(curvatures));
+        this->node_weights_.push_back(std::move(nodes));
+    }
+
+    this->par_yields_.assign(count, 0.);
+    this->is_priced_.assign(count, false);
+    this->curvatures_.assign(count, 0.);
+    this->node_par_yields_.assign(node_count, 0.);
+    this->discount_factors_.assign(node_count, 1.);
+    this->annuities_.assign(node_count, 0.);
+    this->in_listener_ = new PricingToCurveListener<T>(this);
+}
+
+template<typename T>
+CurveService<T>::~CurveService() {
+    delete this->in_listener_;
+}
+
+template<typename T>
+YieldCurve<T>& CurveService<T>::GetData(std::string name) {
+    std::shared_ptr<YieldCurve<T>> curve = std::atomic_load_explicit(&this->curve_, std::memory_order_acquire);
+    if (!curve || name != this->name_) {
+        throw std::out_of_range("CurveService: no curve " + name);
+    }
+    return *curve;
+}
+
+template<typename T>
+void CurveService<T>::OnMessage(YieldCurve<T>& data) {
+    std::atomic_store_explicit(&this->curve_, std::make_shared<YieldCurve<T>>(data), std::memory_order_release);
+}
+
+template<typename T>
+void CurveService<T>::AddListener(ServiceListener<YieldCurve<T>>* listener) {
+    this->Service<string, YieldCurve<T>>::AddListener(listener);
+}
+
+template<typename T>
+const vector<ServiceListener<YieldCurve<T>>*>& CurveService<T>::GetListeners() const {
+    return this->Service<string, YieldCurve<T>>::GetListeners();
+}
+
+template<typename T>
+PricingToCurveListener<T>* CurveService<T>::GetInListener() {
+    return this->in_listener_;
+}
+
+template<typename T>
+void CurveService<T>::AddPrice(const Price<T>& price) {
+    ProductHandle product = price.GetProductHandle();
+    if (!this->points_.Contains(product)) return;
+
+    // Benchmarks may tick on several shards, the curve is rebuilt one move at a time
+    std::lock_guard<std::mutex> lock(this->build_mutex_);
+    double par_yield = this->analytics_.GetRisk(product, price.GetMid()).yield;
+    this->Rebuild(this->points_.At(product), par_yield);
+}
+
+template<typename T>
+std::shared_ptr<const YieldCurve<T>> CurveService<T>::GetCurve() const {
+    return std::atomic_load_explicit(&this->curve_, std::memory_order_acquire);
+}
+
+template<typename T>
+double CurveService<T>::GetFairPrice(ProductHandle product) {
+    std::shared_ptr<const YieldCurve<T>> curve = this->GetCurve();
+    if (!curve) {
+        throw std::out_of_range("CurveService: " + this->name_ + " is not built yet");
+    }
+    std::lock_guard<std::mutex> lock(this->build_mutex_);
+    return this->analytics_.ComputePrice(product, [&curve](double tenor) { return curve->GetDiscountFactor(tenor); });
+}
+
+template<typename T>
+void CurveService<T>::Rebuild(std::size_t point, double par_yield) {
+    double delta = par_yield - this->par_yields_[point];
+    if (this->is_priced_[point] && delta == 0.) return;
+    if (!this->is_priced_[point]) {
+        this->is_priced_[point] = true;
+        this->priced_count_++;
+    }
+    this->par_yields_[point] = par_yield;
+
+    // Add the column of the moving benchmark to the spline and the grid
+    const std::vector<double>& curvature_weights = this->curvature_weights_[point];
+    for (std::size_t i = 0; i < this->curvatures_.size(); i++) {
+        this->curvatures_[i] += curvature_weights[i] * delta;
+    }
+    const std::vector<double>& node_weights = this->node_weights_[point];
+    std::size_t first_node = node_weights.size();
+    for (std::size_t node = 0; node < node_weights.size(); node++) {
+        if (node_weights[node] == 0.) continue;
+        this->node_par_yields_[node] += node_weights[node] * delta;
+        if (first_node == node_weights.size()) first_node = node;
+    }
+    if (this->priced_count_ < this->par_yields_.size()) return;
+
+    // Every grid node is a par bond, its coupons on the annuity plus par discount to 1,
+    // so the annuity runs as A(n) = (A(n - 1) + 1) / (1 + c(n)) and DF(n) = A(n) - A(n - 1)
+    // The divisions are independent, which leaves one multiply-add per node on the chain
+    // A curve built for the first time starts from the front
+    if (this->version_ == 0) first_node = 0;
+    std::size_t node_count = this->discount_factors_.size();
+    for (std::size_t node = first_node; node < node_count; node++) {
+        this->discount_factors_[node] = 1. / (1. + this->node_par_yields_[node] / 2.);
+    }
+    double annuity = (first_node == 0) ? 0. : this->annuities_[first_node - 1];
+    for (std::size_t node = first_node; node < node_count; node++) {
+        double next = (annuity + 1.) * this->discount_factors_[node];
+        this->discount_factors_[node] = next - annuity;
+        this->annuities_[node] = next;
+        annuity = next;
+    }
+
+    auto curve = std::make_shared<YieldCurve<T>>(this->name_, ++this->version_, this->tenors_, this->par_yields_,
+        this->curvatures_, this->discount_factors_);
+    std::atomic_store_explicit(&this->curve_, curve, std::memory_order_release);
+
+    // Notify listeners
+    for (auto& l : Service<string, YieldCurve<T>>::listeners_) {
+        l->ProcessAdd(*curve);
+    }
+}
+
+template<typename T>
+PricingToCurveListener<T>::PricingToCurveListener(CurveService<T>* service) : service_(service) {}
+
+template<typename T>
+void PricingToCurveListener<T>::ProcessAdd(Price<T>& data)
+{
+    this->service_->AddPrice(data);
+}
+
+template<typename T>
+void PricingToCurveListener<T>::ProcessRemove(Price<T>& data) {}
+
+template<typename T>
+void PricingToCurveListener<T>::ProcessUpdate(Price<T>& data) {}
+
+#endif
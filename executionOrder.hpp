@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <string>
+#include <utility>
+#include "priceTicks.hpp"
+#include "productRegistry.hpp"
 
 enum OrderType { FOK, IOC, MARKET, LIMIT, STOP };
 enum Market { BROKERTEC, ESPEED, CME };
@@ -19,11 +22,15 @@ public:
 
     ExecutionOrder() = default;
     // ctor for an order
-    ExecutionOrder(const T& _product, PricingSide _side, std::string _orderId, OrderType _orderType, double _price, double _visibleQuantity, double _hiddenQuantity, std::string _parentOrderId, bool _isChildOrder);
+    ExecutionOrder(const T& _product, PricingSide _side, std::string _orderId, OrderType _orderType, Ticks256 _price, double _visibleQuantity, double _hiddenQuantity, std::string _parentOrderId, bool _isChildOrder);
+    ExecutionOrder(ProductHandle _product, PricingSide _side, std::string _orderId, OrderType _orderType, Ticks256 _price, double _visibleQuantity, double _hiddenQuantity, std::string _parentOrderId, bool _isChildOrder);
 
     // Get the product
     const T& GetProduct() const;
 
+    // Get the interned product handle
+    ProductHandle GetProductHandle() const;
+
     // Get pricing side
     PricingSide GetPricingSide() const;
 
@@ -34,7 +41,7 @@ public:
     OrderType GetOrderType() const;
 
     // Get the price on this order
-    double GetPrice() const;
+    Ticks256 GetPrice() const;
 
     // Get the visible quantity on this order
     long GetVisibleQuantity() const;
@@ -51,11 +58,11 @@ public:
     std::vector<std::string> ToString() const;
 
 private:
-    T product_;
+    ProductHandle product_ = kInvalidProductHandle;
     PricingSide side_;
     std::string orderId_;
     OrderType orderType_;
-    double price_;
+    Ticks256 price_;
     double visibleQuantity_;
     double hiddenQuantity_;
     std::string parentOrderId_;
@@ -65,15 +72,25 @@ private:
 
 
 template<typename T>
-ExecutionOrder<T>::ExecutionOrder(const T& product, PricingSide side, std::string orderId, OrderType orderType, double price, double visibleQuantity, double hiddenQuantity, std::string parentOrderId, bool isChildOrder) :
-    product_(product), side_(side), orderId_(orderId),
+ExecutionOrder<T>::ExecutionOrder(const T& product, PricingSide side, std::string orderId, OrderType orderType, Ticks256 price, double visibleQuantity, double hiddenQuantity, std::string parentOrderId, bool isChildOrder) :
+    ExecutionOrder(ProductRegistry<T>::Instance().Intern(product), side, std::move(orderId), orderType, price, visibleQuantity, hiddenQuantity, std::move(parentOrderId), isChildOrder) {}
+
+template<typename T>
+ExecutionOrder<T>::ExecutionOrder(ProductHandle product, PricingSide side, std::string orderId, OrderType orderType, Ticks256 price, double visibleQuantity, double hiddenQuantity, std::string parentOrderId, bool isChildOrder) :
+    product_(product), side_(side), orderId_(std::move(orderId)),
     orderType_(orderType), price_(price), visibleQuantity_(visibleQuantity),
-    hiddenQuantity_(hiddenQuantity), parentOrderId_(parentOrderId),
+    hiddenQuantity_(hiddenQuantity), parentOrderId_(std::move(parentOrderId)),
     isChildOrder_(isChildOrder) {}
 
 
 template<typename T>
 const T& ExecutionOrder<T>::GetProduct() const
+{
+    return ProductRegistry<T>::Instance().Get(this->product_);
+}
+
+template<typename T>
+ProductHandle ExecutionOrder<T>::GetProductHandle() const
 {
     return this->product_;
 }
@@ -96,7 +113,7 @@ OrderType ExecutionOrder<T>::GetOrderType() const
 }
 
 template<typename T>
-double ExecutionOrder<T>::GetPrice() const
+Ticks256 ExecutionOrder<T>::GetPrice() const
 {
     return this->price_;
 }
@@ -128,7 +145,7 @@ bool ExecutionOrder<T>::IsChildOrder() const
 template<typename T>
 std::vector<std::string> ExecutionOrder<T>::ToString() const
 {
-    std::string _product = product_.GetProductId();
+    std::string _product = this->GetProduct().GetProductId();
     std::string _side;
     switch (this->side_)
     {
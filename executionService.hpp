@@ -21,7 +21,7 @@ template<typename T>
 class ExecutionService : public Service<string, ExecutionOrder <T> >
 {
 private:
-    unordered_map<string, ExecutionOrder<T>> execution_orders_;
+    ProductTable<ExecutionOrder<T>> execution_orders_;
     AlgoExecutionToExecutionListener<T>* in_listener_;
     
 public:
@@ -34,6 +34,9 @@ public:
     
     // The callback that a Connector should invoke for any new or updated data
     virtual void OnMessage(ExecutionOrder<T>& data) override;
+
+    // The callback for data the caller hands over, moved into the service
+    virtual void OnMessage(ExecutionOrder<T>&& data) override;
     
     // Add a listener to the Service for callbacks on add, remove, and update events
     // for data to the Service.
@@ -46,12 +49,12 @@ public:
     AlgoExecutionToExecutionListener<T>* GetInListener();
     
     // Execute an order on a market
-    void ExecuteOrder(ExecutionOrder<T> order, Market market = CME);
+    void ExecuteOrder(const ExecutionOrder<T>& order, Market market = CME);
 
 };
 
 template <typename T>
-class AlgoExecutionToExecutionListener : public ServiceListener<AlgoExecutionOrder<T>> {
+class AlgoExecutionToExecutionListener final : public ServiceListener<AlgoExecutionOrder<T>> {
 private:
     ExecutionService<T>* service_;
     
@@ -83,14 +86,12 @@ ExecutionService<T>::~ExecutionService() {
 
 template<typename T>
 ExecutionOrder<T>& ExecutionService<T>::GetData(string product_id) {
-    return this->execution_orders_.at(product_id);
+    return this->execution_orders_.At(ProductRegistry<T>::Instance().Find(product_id));
 }
 
 template<typename T>
 void ExecutionService<T>::OnMessage(ExecutionOrder<T>& data) {
-    string product_id = data.GetProduct().GetProductId();
-    
-    this->execution_orders_.insert_or_assign(product_id, data);
+    this->execution_orders_.InsertOrAssign(data.GetProductHandle(), data);
     
     // Also notify listeners
     for (auto& listener : this->listeners_) {
@@ -98,6 +99,17 @@ void ExecutionService<T>::OnMessage(ExecutionOrder<T>& data) {
     }
 }
 
+template<typename T>
+void ExecutionService<T>::OnMessage(ExecutionOrder<T>&& data) {
+    ProductHandle product = data.GetProductHandle();
+    ExecutionOrder<T>& order = this->execution_orders_.InsertOrAssign(product, std::move(data));
+    
+    // Also notify listeners
+    for (auto& listener : this->listeners_) {
+        listener->ProcessAdd(order);
+    }
+}
+
 template<typename T>
 void ExecutionService<T>::AddListener(ServiceListener<ExecutionOrder<T>>* listener) {
     this->Service<string, ExecutionOrder<T>>::AddListener(listener);
@@ -114,14 +126,14 @@ AlgoExecutionToExecutionListener<T>* ExecutionService<T>::GetInListener() {
 }
 
 template<typename T>
-void ExecutionService<T>::ExecuteOrder(ExecutionOrder<T> order, Market market)
+void ExecutionService<T>::ExecuteOrder(const ExecutionOrder<T>& order, Market market)
 {
-    string _productId = order.GetProduct().GetProductId();
-    this->execution_orders_[_productId] = order;
+    // Listeners get the stored order, no copy is made for them
+    ExecutionOrder<T>& executed = this->execution_orders_.InsertOrAssign(order.GetProductHandle(), order);
 
     for (auto& l : Service<string, ExecutionOrder<T>>::listeners_)
     {
-        l->ProcessAdd(order);
+        l->ProcessAdd(executed);
     }
 }
 
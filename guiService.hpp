@@ -4,6 +4,13 @@
 
 #include "pricingService.hpp"
 #include "utilities.hpp"
+#include "recordWriter.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 template<typename T>
@@ -11,17 +18,49 @@ class GUIConnector;
 template<typename T>
 class PricingToGUIListener;
 
+/**
+ * GUI Service conflating prices per product before they reach the GUI.
+ * An incoming price only overwrites the latest price of its product. A token bucket
+ * on steady_clock, refilled once per throttle interval, decides when the conflated
+ * snapshot of every product updated since the last flush is published, so the GUI
+ * always shows the freshest prices at a bounded rate.
+ * A timer thread publishes products still pending once a token is due, so the last
+ * prices of a burst reach the GUI without waiting for another tick. Incoming prices
+ * and flushes are serialized on a mutex.
+ * Type T is the product type.
+ */
 template<typename T>
 class GUIService : Service<string, Price<T>> {
 private:
-    unordered_map<string, Price<T>> guis_;
+    typedef std::chrono::steady_clock Clock;
+
+    ProductTable<Price<T>> guis_;
     GUIConnector<T>* out_connector_;
-    ServiceListener<Price<T>>* in_listener_;
-    int throttle_;
-    long millisec_;
+    PricingToGUIListener<T>* in_listener_;
+    Clock::duration throttle_;
+    long burst_;
+    long tokens_;
+    Clock::time_point last_refill_;
+    // Products updated since the last flush, in order of their first update
+    vector<ProductHandle> dirty_products_;
+    vector<char> is_dirty_;
+    bool is_stopping_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread timer_;
+
+    // Refill the token bucket and take a token, returns false if the bucket is empty
+    bool TryAcquireToken(Clock::time_point now);
+
+    // Publish every pending product, must be called with mutex_ held
+    void FlushLocked();
+
+    // Body of the timer thread
+    void Run();
 
 public:
-    GUIService();
+    // ctor publishing at most burst snapshots per throttle interval
+    GUIService(std::chrono::milliseconds _throttle = std::chrono::milliseconds(300), long _burst = 1);
     ~GUIService();
 
     // Get data on our service given a key (orderbook)
@@ -40,16 +79,13 @@ public:
     PricingConnector<T>* GetConnector();
 
     // Get the listener of the service
-    ServiceListener<Price<T>>* GetInListener();
-
-    // Get the throttle of the service
-    int GetThrottle() const;
+    PricingToGUIListener<T>* GetInListener();
 
-    // Get the millisec of the service
-    long GetMillisec() const;
+    // Get the throttle interval of the service
+    std::chrono::milliseconds GetThrottle() const;
 
-    // Set the millisec of the service
-    void SetMillisec(long _millisec);
+    // Publish the latest price of every product updated since the last flush
+    void Flush();
 
 };
 
@@ -57,6 +93,8 @@ template<typename T>
 class GUIConnector : public Connector<Price<T>> {
 private:
     GUIService<T>* service_;
+    std::unique_ptr<RecordWriter> writer_;
+    string record_;
 
 public:
     GUIConnector(GUIService<T>* _service);
@@ -68,10 +106,13 @@ public:
     // Subscribe data from the Connector
     void Subscribe(ifstream& data);
 
+    // Subscribe data from a memory-mapped file
+    void Subscribe(const MappedFile& data);
+
 };
 
 template<typename T>
-class PricingToGUIListener : public ServiceListener<Price<T>> {
+class PricingToGUIListener final : public ServiceListener<Price<T>> {
 private:
     GUIService<T>* service_;
 
@@ -93,28 +134,87 @@ public:
 };
 
 template<typename T>
-GUIService<T>::GUIService() : throttle_(300), millisec_(0) {
+GUIService<T>::GUIService(std::chrono::milliseconds throttle, long burst) :
+    throttle_(throttle), burst_(burst), tokens_(burst), last_refill_(Clock::now()), is_stopping_(false) {
     this->out_connector_ = new GUIConnector<T>(this);
     this->in_listener_ = new PricingToGUIListener<T>(this);
+    this->timer_ = std::thread(&GUIService::Run, this);
 }
 
 template<typename T>
 GUIService<T>::~GUIService() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_stopping_ = true;
+    }
+    wake_.notify_one();
+    timer_.join();
+
+    // Whatever was conflated since the last flush is still the freshest state
+    this->Flush();
     delete this->out_connector_;
     delete this->in_listener_;
 }
 
 template <typename T>
 Price<T>& GUIService<T>::GetData(string product_id) {
-    return this->guis_[product_id];
+    return this->guis_[ProductRegistry<T>::Instance().Find(product_id)];
 }
 
 template <typename T>
 void GUIService<T>::OnMessage(Price<T>& data) {
-    string product_id = data.GetProduct().GetProductId();
-    
-    this->guis_.insert_or_assign(product_id, data);
-    this->out_connector_->Publish(data);
+    std::lock_guard<std::mutex> lock(mutex_);
+    ProductHandle product = data.GetProductHandle();
+    this->guis_.InsertOrAssign(product, data);
+    if (product >= is_dirty_.size()) is_dirty_.resize(product + 1, 0);
+    if (!is_dirty_[product]) {
+        is_dirty_[product] = 1;
+        dirty_products_.push_back(product);
+    }
+
+    if (this->TryAcquireToken(Clock::now())) {
+        this->FlushLocked();
+    }
+}
+
+template<typename T>
+bool GUIService<T>::TryAcquireToken(Clock::time_point now) {
+    long refill = long((now - last_refill_) / throttle_);
+    if (refill > 0) {
+        tokens_ = std::min(burst_, tokens_ + refill);
+        last_refill_ += refill * throttle_;
+    }
+    if (tokens_ == 0) return false;
+    tokens_--;
+    return true;
+}
+
+template<typename T>
+void GUIService<T>::Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    this->FlushLocked();
+}
+
+template<typename T>
+void GUIService<T>::FlushLocked() {
+    for (ProductHandle product : dirty_products_) {
+        is_dirty_[product] = 0;
+        this->out_connector_->Publish(this->guis_[product]);
+    }
+    dirty_products_.clear();
+}
+
+template<typename T>
+void GUIService<T>::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!is_stopping_) {
+        // Pending products were left by an empty bucket, so wake when its next token is due
+        Clock::time_point deadline = dirty_products_.empty() ? Clock::now() + throttle_ : last_refill_ + throttle_;
+        wake_.wait_until(lock, deadline, [this]() { return is_stopping_; });
+        if (!is_stopping_ && !dirty_products_.empty() && this->TryAcquireToken(Clock::now())) {
+            this->FlushLocked();
+        }
+    }
 }
 
 template <typename T>
@@ -133,54 +233,38 @@ PricingConnector<T>* GUIService<T>::GetConnector() {
 }
 
 template <typename T>
-ServiceListener<Price<T>>* GUIService<T>::GetInListener() {
+PricingToGUIListener<T>* GUIService<T>::GetInListener() {
     return this->in_listener_;
 }
 
 template<typename T>
-int GUIService<T>::GetThrottle() const {
-    return this->throttle_;
+std::chrono::milliseconds GUIService<T>::GetThrottle() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(this->throttle_);
 }
 
 template<typename T>
-long GUIService<T>::GetMillisec() const {
-    return this->millisec_;
-}
-
-template<typename T>
-void GUIService<T>::SetMillisec(long millisec) {
-    this->millisec_ = millisec;
-}
-
-template<typename T>
-GUIConnector<T>::GUIConnector(GUIService<T>* service) : service_(service) {}
+GUIConnector<T>::GUIConnector(GUIService<T>* service) : service_(service), writer_(new RecordWriter("gui.txt")) {}
 
 template<typename T>
 void GUIConnector<T>::Publish(Price<T>& data)
 {
-    int throttle = this->service_->GetThrottle();
-    long millisec = this->service_->GetMillisec();
-    long millisec_now = GetMillisecond();
-    while (millisec_now < millisec) millisec_now += 1000;
-    if (millisec_now - millisec >= throttle)
+    record_.assign(1, ',');
+    vector<string> strings = data.ToString();
+    for (auto& s : strings)
     {
-        this->service_->SetMillisec(millisec_now);
-        ofstream file;
-        file.open("gui.txt", ios::app);
-
-        file << ",";
-        vector<string> strings = data.ToString();
-        for (auto& s : strings)
-        {
-            file << s << ",";
-        }
-        file << endl;
+        record_.append(s);
+        record_.push_back(',');
     }
+    record_.push_back('\n');
+    this->writer_->Append(record_);
 }
 
 template<typename T>
 void GUIConnector<T>::Subscribe(ifstream& data) {}
 
+template<typename T>
+void GUIConnector<T>::Subscribe(const MappedFile& data) {}
+
 template<typename T>
 PricingToGUIListener<T>::PricingToGUIListener(GUIService<T>* service) : service_(service) {}
 
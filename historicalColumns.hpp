@@ -0,0 +1,171 @@
+
+#ifndef HistoricalColumns_HPP
+#define HistoricalColumns_HPP
+
+#include <cstdint>
+#include <vector>
+#include "columnarStore.hpp"
+#include "positionService.hpp"
+#include "riskService.hpp"
+#include "executionOrder.hpp"
+#include "priceStream.hpp"
+#include "inquiryService.hpp"
+
+/**
+ * Columnar layout of each record the historical data service persists.
+ * Columns() lists the columns after the timestamp, Append() writes the record
+ * as one or more rows stamped with the given timestamp.
+ * Prices are stored as raw 1/256 ticks and enums as their int8 codes.
+ * Type V is the record type.
+ */
+template<typename V>
+struct HistoricalColumns;
+
+// Width of product identifier columns, every cusip fits
+const std::uint32_t kProductIdWidth = 12;
+// Width of order and inquiry identifier columns
+const std::uint32_t kRecordIdWidth = 16;
+
+// One row per book
+template<typename T>
+struct HistoricalColumns<Position<T>>
+{
+    static std::vector<ColumnSpec> Columns()
+    {
+        return {
+            ColumnSpec("product", TEXT_COLUMN, kProductIdWidth),
+            ColumnSpec("book", TEXT_COLUMN, 8),
+            ColumnSpec("position", INT64_COLUMN)
+        };
+    }
+
+    static void Append(const Position<T>& position, ColumnarWriter& writer, std::int64_t timestamp)
+    {
+        const string& product_id = position.GetProduct().GetProductId();
+        position.ForEachBook([&](const string& book, long quantity) {
+            writer.BeginRow(timestamp);
+            writer.SetText(1, product_id);
+            writer.SetText(2, book);
+            writer.SetInt(3, quantity);
+            writer.EndRow();
+        });
+    }
+};
+
+template<typename T>
+struct HistoricalColumns<PV01<T>>
+{
+    static std::vector<ColumnSpec> Columns()
+    {
+        return {
+            ColumnSpec("product", TEXT_COLUMN, kProductIdWidth),
+            ColumnSpec("pv01", FLOAT64_COLUMN),
+            ColumnSpec("quantity", INT64_COLUMN)
+        };
+    }
+
+    static void Append(const PV01<T>& pv01, ColumnarWriter& writer, std::int64_t timestamp)
+    {
+        writer.BeginRow(timestamp);
+        writer.SetText(1, pv01.GetProduct().GetProductId());
+        writer.SetDouble(2, pv01.GetPV01());
+        writer.SetInt(3, pv01.GetQuantity());
+        writer.EndRow();
+    }
+};
+
+template<typename T>
+struct HistoricalColumns<ExecutionOrder<T>>
+{
+    static std::vector<ColumnSpec> Columns()
+    {
+        return {
+            ColumnSpec("product", TEXT_COLUMN, kProductIdWidth),
+            ColumnSpec("side", INT8_COLUMN),
+            ColumnSpec("order_id", TEXT_COLUMN, kRecordIdWidth),
+            ColumnSpec("order_type", INT8_COLUMN),
+            ColumnSpec("price_ticks", INT64_COLUMN),
+            ColumnSpec("visible_quantity", INT64_COLUMN),
+            ColumnSpec("hidden_quantity", INT64_COLUMN),
+            ColumnSpec("parent_order_id", TEXT_COLUMN, kRecordIdWidth),
+            ColumnSpec("is_child_order", INT8_COLUMN)
+        };
+    }
+
+    static void Append(const ExecutionOrder<T>& order, ColumnarWriter& writer, std::int64_t timestamp)
+    {
+        writer.BeginRow(timestamp);
+        writer.SetText(1, order.GetProduct().GetProductId());
+        writer.SetInt(2, order.GetPricingSide());
+        writer.SetText(3, order.GetOrderId());
+        writer.SetInt(4, order.GetOrderType());
+        writer.SetInt(5, order.GetPrice().GetTicks());
+        writer.SetInt(6, order.GetVisibleQuantity());
+        writer.SetInt(7, order.GetHiddenQuantity());
+        writer.SetText(8, order.GetParentOrderId());
+        writer.SetInt(9, order.IsChildOrder());
+        writer.EndRow();
+    }
+};
+
+template<typename T>
+struct HistoricalColumns<PriceStream<T>>
+{
+    static std::vector<ColumnSpec> Columns()
+    {
+        return {
+            ColumnSpec("product", TEXT_COLUMN, kProductIdWidth),
+            ColumnSpec("bid_price_ticks", INT64_COLUMN),
+            ColumnSpec("bid_visible_quantity", INT64_COLUMN),
+            ColumnSpec("bid_hidden_quantity", INT64_COLUMN),
+            ColumnSpec("offer_price_ticks", INT64_COLUMN),
+            ColumnSpec("offer_visible_quantity", INT64_COLUMN),
+            ColumnSpec("offer_hidden_quantity", INT64_COLUMN)
+        };
+    }
+
+    static void Append(const PriceStream<T>& stream, ColumnarWriter& writer, std::int64_t timestamp)
+    {
+        const PriceStreamOrder& bid = stream.GetBidOrder();
+        const PriceStreamOrder& offer = stream.GetOfferOrder();
+        writer.BeginRow(timestamp);
+        writer.SetText(1, stream.GetProduct().GetProductId());
+        writer.SetInt(2, bid.GetPrice().GetTicks());
+        writer.SetInt(3, bid.GetVisibleQuantity());
+        writer.SetInt(4, bid.GetHiddenQuantity());
+        writer.SetInt(5, offer.GetPrice().GetTicks());
+        writer.SetInt(6, offer.GetVisibleQuantity());
+        writer.SetInt(7, offer.GetHiddenQuantity());
+        writer.EndRow();
+    }
+};
+
+template<typename T>
+struct HistoricalColumns<Inquiry<T>>
+{
+    static std::vector<ColumnSpec> Columns()
+    {
+        return {
+            ColumnSpec("inquiry_id", TEXT_COLUMN, kRecordIdWidth),
+            ColumnSpec("product", TEXT_COLUMN, kProductIdWidth),
+            ColumnSpec("side", INT8_COLUMN),
+            ColumnSpec("quantity", INT64_COLUMN),
+            ColumnSpec("price_ticks", INT64_COLUMN),
+            ColumnSpec("state", INT8_COLUMN)
+        };
+    }
+
+    static void Append(const Inquiry<T>& inquiry, ColumnarWriter& writer, std::int64_t timestamp)
+    {
+        writer.BeginRow(timestamp);
+        writer.SetText(1, inquiry.GetInquiryId());
+        writer.SetText(2, inquiry.GetProduct().GetProductId());
+        writer.SetInt(3, inquiry.GetSide());
+        writer.SetInt(4, inquiry.GetQuantity());
+        writer.SetInt(5, inquiry.GetPrice().GetTicks());
+        writer.SetInt(6, inquiry.GetState());
+        writer.EndRow();
+    }
+};
+
+#endif
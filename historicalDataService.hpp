@@ -3,10 +3,20 @@
 
 #include "soa.hpp"
 #include <unordered_map>
+#include <type_traits>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
 #include "utilities.hpp"
+#include "recordWriter.hpp"
+#include "historicalColumns.hpp"
 
 enum ServiceType { POSITION, RISK, EXECUTION, STREAMING, INQUIRY };
 
+// Layout of the persistent store: comma-separated text, or binary columns (optionally LZ compressed)
+enum StoreFormat { TEXT_STORE, COLUMNAR_STORE, COMPRESSED_COLUMNAR_STORE };
+
 template<typename T>
 class HistoricalDataConnector;
 template<typename T>
@@ -21,14 +31,19 @@ template<typename T>
 class HistoricalDataService : Service<string, T>
 {
 private:
-    unordered_map<string, T> historical_datas_;
+    // Product type the persisted data refers to
+    typedef typename std::decay<decltype(std::declval<T>().GetProduct())>::type ProductType;
+
+    ProductTable<T> historical_datas_;
     HistoricalDataConnector<T>* out_connector_;
-    ServiceListener<T>* in_listener_;
+    HistoricalDataListener<T>* in_listener_;
     ServiceType type_;
+    WriterPolicy policy_;
+    StoreFormat format_;
 
 public:
     HistoricalDataService();
-    HistoricalDataService(ServiceType _type);
+    HistoricalDataService(ServiceType _type, WriterPolicy _policy = WriterPolicy(), StoreFormat _format = TEXT_STORE);
     ~HistoricalDataService();
 
     // Get data on our service given a key (orderbook)
@@ -48,18 +63,28 @@ public:
     HistoricalDataConnector<T>* GetConnector();
 
     // Get the listener of the service
-    ServiceListener<T>* GetInListener();
+    HistoricalDataListener<T>* GetInListener();
 
     // Persist data to a store
-    void PersistData(string persistKey, T data);
+    void PersistData(ProductHandle persistKey, T& data);
 
     ServiceType GetServiceType() const;
+
+    // Get the durability settings of the persistent store
+    const WriterPolicy& GetWriterPolicy() const;
+
+    // Get the layout of the persistent store
+    StoreFormat GetStoreFormat() const;
 };
 
 template<typename T>
 class HistoricalDataConnector : public Connector<T> {
 private:
     HistoricalDataService<T>* service_;
+    // The store stays open for the whole run, records are batched and written by its flusher
+    std::unique_ptr<RecordWriter> writer_;
+    std::unique_ptr<ColumnarWriter> columnar_writer_;
+    string record_;
 
 public:
     HistoricalDataConnector(HistoricalDataService<T>* service_);
@@ -71,10 +96,16 @@ public:
     // Subscribe data from the Connector
     virtual void Subscribe(ifstream& data) override;
 
+    // Subscribe data from a memory-mapped file
+    virtual void Subscribe(const MappedFile& data) override;
+
+    // Write every pending record to the store now
+    void Flush();
+
 };
 
 template<typename T>
-class HistoricalDataListener : public ServiceListener<T> {
+class HistoricalDataListener final : public ServiceListener<T> {
 private:
     HistoricalDataService<T>* service_;
 
@@ -97,13 +128,14 @@ public:
 
 
 template<typename T>
-HistoricalDataService<T>::HistoricalDataService() : type_(INQUIRY) {
+HistoricalDataService<T>::HistoricalDataService() : type_(INQUIRY), format_(TEXT_STORE) {
     this->out_connector_ = new HistoricalDataConnector<T>(this);
     this->in_listener_ = new HistoricalDataListener<T>(this);
 }
 
 template<typename T>
-HistoricalDataService<T>::HistoricalDataService(ServiceType type) : type_(type) {
+HistoricalDataService<T>::HistoricalDataService(ServiceType type, WriterPolicy policy, StoreFormat format) :
+    type_(type), policy_(policy), format_(format) {
     this->out_connector_ = new HistoricalDataConnector<T>(this);
     this->in_listener_ = new HistoricalDataListener<T>(this);
 }
@@ -116,13 +148,12 @@ HistoricalDataService<T>::~HistoricalDataService() {
 
 template <typename T>
 T& HistoricalDataService<T>::GetData(string product_id) {
-    return this->historical_datas_[product_id];
+    return this->historical_datas_[ProductRegistry<ProductType>::Instance().Find(product_id)];
 }
 
 template <typename T>
 void HistoricalDataService<T>::OnMessage(T& data) {
-    string product_id = data.GetProduct().GetProductId();
-    this->historical_datas_[product_id] = data;
+    this->historical_datas_[data.GetProductHandle()] = data;
 }
 
 template <typename T>
@@ -136,7 +167,7 @@ const vector<ServiceListener<T>*>& HistoricalDataService<T>::GetListeners() cons
 }
 
 template <typename T>
-ServiceListener<T>* HistoricalDataService<T>::GetInListener() {
+HistoricalDataListener<T>* HistoricalDataService<T>::GetInListener() {
     return this->in_listener_;
 }
 
@@ -152,49 +183,91 @@ ServiceType HistoricalDataService<T>::GetServiceType() const
 }
 
 template<typename T>
-void HistoricalDataService<T>::PersistData(string persistKey, T data) {
-    this->out_connector_->Publish(data);
+const WriterPolicy& HistoricalDataService<T>::GetWriterPolicy() const
+{
+    return this->policy_;
 }
 
 template<typename T>
-HistoricalDataConnector<T>::HistoricalDataConnector(HistoricalDataService<T>* service) : service_(service) {}
+StoreFormat HistoricalDataService<T>::GetStoreFormat() const
+{
+    return this->format_;
+}
 
 template<typename T>
-void HistoricalDataConnector<T>::Publish(T& data)
+void HistoricalDataService<T>::PersistData(ProductHandle persistKey, T& data) {
+    this->out_connector_->Publish(data);
+}
+
+template<typename T>
+HistoricalDataConnector<T>::HistoricalDataConnector(HistoricalDataService<T>* service) : service_(service)
 {
-    ServiceType type = this->service_->GetServiceType();
-    ofstream file;
-    switch (type)
+    string path;
+    switch (service_->GetServiceType())
     {
     case POSITION:
-        file.open("positions.txt", ios::app);
+        path = "positions";
         break;
     case RISK:
-        file.open("risk.txt", ios::app);
+        path = "risk";
         break;
     case EXECUTION:
-        file.open("executions.txt", ios::app);
+        path = "executions";
         break;
     case STREAMING:
-        file.open("streaming.txt", ios::app);
+        path = "streaming";
         break;
     case INQUIRY:
-        file.open("allinquiries.txt", ios::app);
+        path = "allinquiries";
         break;
     }
 
-    file << ",";
+    StoreFormat format = service_->GetStoreFormat();
+    if (format == TEXT_STORE) {
+        this->writer_.reset(new RecordWriter(path + ".txt", service_->GetWriterPolicy()));
+    } else {
+        this->columnar_writer_.reset(new ColumnarWriter(path + ".col", HistoricalColumns<T>::Columns(),
+            format == COMPRESSED_COLUMNAR_STORE, 4096, service_->GetWriterPolicy()));
+    }
+}
+
+template<typename T>
+void HistoricalDataConnector<T>::Publish(T& data)
+{
+    if (this->columnar_writer_) {
+        std::int64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        HistoricalColumns<T>::Append(data, *this->columnar_writer_, timestamp);
+        return;
+    }
+
+    record_.assign(1, ',');
     vector<string> strings = data.ToString();
     for (auto& s : strings)
     {
-        file << s << ",";
+        record_.append(s);
+        record_.push_back(',');
     }
-    file << endl;
+    record_.push_back('\n');
+    this->writer_->Append(record_);
+}
+
+template<typename T>
+void HistoricalDataConnector<T>::Flush()
+{
+    if (this->columnar_writer_) {
+        this->columnar_writer_->Flush();
+        return;
+    }
+    this->writer_->Flush();
 }
 
 template<typename T>
 void HistoricalDataConnector<T>::Subscribe(ifstream& data) {}
 
+template<typename T>
+void HistoricalDataConnector<T>::Subscribe(const MappedFile& data) {}
+
 template<typename T>
 HistoricalDataListener<T>::HistoricalDataListener(HistoricalDataService<T>* service)
 {
@@ -204,8 +277,7 @@ HistoricalDataListener<T>::HistoricalDataListener(HistoricalDataService<T>* serv
 template<typename T>
 void HistoricalDataListener<T>::ProcessAdd(T& data)
 {
-    string product_id = data.GetProduct().GetProductId();
-    this->service_->PersistData(product_id, data);
+    this->service_->PersistData(data.GetProductHandle(), data);
 }
 
 template<typename T>
@@ -4,6 +4,8 @@
 
 #include "soa.hpp"
 #include "tradeBookingService.hpp"
+#include "latencyMonitor.hpp"
+#include <stdexcept>
 #include <unordered_map>
 
  // Various inqyury states
@@ -21,7 +23,8 @@ public:
 
     Inquiry() = default;
     // ctor for an inquiry
-    Inquiry(string _inquiryId, const T& _product, Side _side, long _quantity, double _price, InquiryState _state);
+    Inquiry(string _inquiryId, const T& _product, Side _side, long _quantity, Ticks256 _price, InquiryState _state);
+    Inquiry(string _inquiryId, ProductHandle _product, Side _side, long _quantity, Ticks256 _price, InquiryState _state);
 
     // Get the inquiry ID
     const string& GetInquiryId() const;
@@ -29,6 +32,9 @@ public:
     // Get the product
     const T& GetProduct() const;
 
+    // Get the interned product handle
+    ProductHandle GetProductHandle() const;
+
     // Get the side on the inquiry
     Side GetSide() const;
 
@@ -36,7 +42,7 @@ public:
     long GetQuantity() const;
 
     // Get the price that we have responded back with
-    double GetPrice() const;
+    Ticks256 GetPrice() const;
 
     // Get the current state on the inquiry
     InquiryState GetState() const;
@@ -47,10 +53,10 @@ public:
 
 private:
     string inquiryId;
-    T product;
+    ProductHandle product = kInvalidProductHandle;
     Side side;
     long quantity;
-    double price;
+    Ticks256 price;
     InquiryState state;
 
 };
@@ -83,6 +89,9 @@ public:
     // The callback that a Connector should invoke for any new or updated data
     virtual void OnMessage(Inquiry<T>& data) override;
 
+    // The callback for data the caller hands over, moved into the service
+    virtual void OnMessage(Inquiry<T>&& data) override;
+
     // Add a listener to the Service for callbacks on add, remove, and update events
     // for data to the Service.
     virtual void AddListener(ServiceListener<Inquiry<T>>* listener) override;
@@ -94,7 +103,7 @@ public:
     InquiryConnector<T>* GetConnector();
 
     // Send a quote back to the client
-    void SendQuote(const string& inquiryId, double price);
+    void SendQuote(const string& inquiryId, Ticks256 price);
 
     // Reject an inquiry from the client
     void RejectInquiry(const string& inquiryId);
@@ -116,20 +125,30 @@ public:
     // Subscribe data from the Connector
     void Subscribe(ifstream& data);
 
+    // Subscribe data from a memory-mapped file
+    void Subscribe(const MappedFile& data);
+
+    // Parse a single line and push it to the service
+    void ParseLine(string_view line);
+
+    // Parse a single non-empty line into an inquiry
+    Inquiry<T> Parse(string_view line) const;
+
     // Re-subscribe data from the Connector
     void Subscribe(Inquiry<T>& data);
 
 };
 
 template<typename T>
-Inquiry<T>::Inquiry(string _inquiryId, const T& _product, Side _side, long _quantity, double _price, InquiryState _state) :
-    product(_product)
+Inquiry<T>::Inquiry(string _inquiryId, const T& _product, Side _side, long _quantity, Ticks256 _price, InquiryState _state) :
+    Inquiry(std::move(_inquiryId), ProductRegistry<T>::Instance().Intern(_product), _side, _quantity, _price, _state)
+{
+}
+
+template<typename T>
+Inquiry<T>::Inquiry(string _inquiryId, ProductHandle _product, Side _side, long _quantity, Ticks256 _price, InquiryState _state) :
+    inquiryId(std::move(_inquiryId)), product(_product), side(_side), quantity(_quantity), price(_price), state(_state)
 {
-    inquiryId = _inquiryId;
-    side = _side;
-    quantity = _quantity;
-    price = _price;
-    state = _state;
 }
 
 template<typename T>
@@ -139,6 +158,12 @@ const string& Inquiry<T>::GetInquiryId() const {
 
 template<typename T>
 const T& Inquiry<T>::GetProduct() const
+{
+    return ProductRegistry<T>::Instance().Get(this->product);
+}
+
+template<typename T>
+ProductHandle Inquiry<T>::GetProductHandle() const
 {
     return this->product;
 }
@@ -156,7 +181,7 @@ long Inquiry<T>::GetQuantity() const
 }
 
 template<typename T>
-double Inquiry<T>::GetPrice() const
+Ticks256 Inquiry<T>::GetPrice() const
 {
     return this->price;
 }
@@ -193,15 +218,22 @@ template<typename T>
 void InquiryService<T>::OnMessage(Inquiry<T>& data)
 {
     InquiryState state = data.GetState();
-    string inquiry_id = data.GetInquiryId();
     switch (state) {
     case RECEIVED:
-        inquiries_.insert_or_assign(inquiry_id, data);
+        inquiries_.insert_or_assign(data.GetInquiryId(), data);
         connector_->Publish(data);
         break;
     case QUOTED:
         data.SetState(DONE);
-        this->inquiries_.insert_or_assign(inquiry_id, data);
+        {
+            // data is the stored inquiry itself when it was moved in
+            auto found = this->inquiries_.find(data.GetInquiryId());
+            if (found == this->inquiries_.end()) {
+                this->inquiries_.emplace(data.GetInquiryId(), data);
+            } else if (&found->second != &data) {
+                found->second = data;
+            }
+        }
 
         for (auto& listener : this->GetListeners())
         {
@@ -213,6 +245,21 @@ void InquiryService<T>::OnMessage(Inquiry<T>& data)
     }
 }
 
+template<typename T>
+void InquiryService<T>::OnMessage(Inquiry<T>&& data)
+{
+    if (data.GetState() != RECEIVED) {
+        this->OnMessage(data);
+        return;
+    }
+
+    // Quote the stored inquiry, the connector hands it back as QUOTED
+    auto [entry, is_new] = inquiries_.try_emplace(data.GetInquiryId(), std::move(data));
+    if (!is_new) entry->second = std::move(data);
+    Inquiry<T>& inquiry = entry->second;
+    connector_->Publish(inquiry);
+}
+
 template<typename T>
 void InquiryService<T>::AddListener(ServiceListener<Inquiry<T>>* listener)
 {
@@ -232,7 +279,7 @@ InquiryConnector<T>* InquiryService<T>::GetConnector()
 }
 
 template<typename T>
-void InquiryService<T>::SendQuote(const string& inquiryId, double price)
+void InquiryService<T>::SendQuote(const string& inquiryId, Ticks256 price)
 {
     Inquiry<T>& inquiry = this->inquiries_[inquiryId];
     inquiry.SetPrice(price);
@@ -269,32 +316,53 @@ void InquiryConnector<T>::Subscribe(ifstream& data)
     string line;
     while (getline(data, line))
     {
-        // Separate line with delimiter ','
-        stringstream line_stream(line);
-        string line_entry;
-        vector<string> line_entries;
-        while (getline(line_stream, line_entry, ',')) {
-            line_entries.push_back(line_entry);
-        }
+        this->ParseLine(line);
+    }
+}
 
-        // Parse data into Inquiry
-        string inquiry_id = line_entries[0];
-        string product_id = line_entries[1];
-        Side side = (line_entries[2] == "BUY") ? BUY : SELL;
-        long quantity = stol(line_entries[3]);
-        double price = ConvertPrice(line_entries[4]);
-        InquiryState state;
-        if (line_entries[5] == "RECEIVED") state = RECEIVED;
-        else if (line_entries[5] == "QUOTED") state = QUOTED;
-        else if (line_entries[5] == "DONE") state = DONE;
-        else if (line_entries[5] == "REJECTED") state = REJECTED;
-        else if (line_entries[5] == "CUSTOMER_REJECTED") state = CUSTOMER_REJECTED;
-        T product = FetchBond(product_id);
-        Inquiry<T> inquiry(inquiry_id, product, side, quantity, price, state);
-        service_->OnMessage(inquiry);
+template<typename T>
+void InquiryConnector<T>::Subscribe(const MappedFile& data)
+{
+    LineReader reader(data.GetView());
+    string_view line;
+    while (reader.Next(line))
+    {
+        this->ParseLine(line);
     }
 }
 
+template<typename T>
+void InquiryConnector<T>::ParseLine(string_view line)
+{
+    if (line.empty()) return;
+    StampIngress();
+
+    service_->OnMessage(this->Parse(line));
+}
+
+template<typename T>
+Inquiry<T> InquiryConnector<T>::Parse(string_view line) const
+{
+    // Separate line with delimiter ','
+    string_view line_entries[6];
+    SplitLine(line, line_entries, 6);
+
+    // Parse data into Inquiry
+    string inquiry_id(line_entries[0]);
+    ProductHandle product = FetchBondHandle(line_entries[1]);
+    Side side = (line_entries[2] == "BUY") ? BUY : SELL;
+    long quantity = ParseLong(line_entries[3]);
+    Ticks256 price = ConvertPrice(line_entries[4]);
+    InquiryState state;
+    if (line_entries[5] == "RECEIVED") state = RECEIVED;
+    else if (line_entries[5] == "QUOTED") state = QUOTED;
+    else if (line_entries[5] == "DONE") state = DONE;
+    else if (line_entries[5] == "REJECTED") state = REJECTED;
+    else if (line_entries[5] == "CUSTOMER_REJECTED") state = CUSTOMER_REJECTED;
+    else throw invalid_argument("InquiryConnector: invalid state '" + string(line_entries[5]) + "'");
+    return Inquiry<T>(inquiry_id, product, side, quantity, price, state);
+}
+
 template<typename T>
 void InquiryConnector<T>::Subscribe(Inquiry<T>& data)
 {
@@ -305,7 +373,7 @@ template<typename T>
 vector<string> Inquiry<T>::ToString() const
 {
     string _inquiryId = inquiryId;
-    string _product = product.GetProductId();
+    string _product = this->GetProduct().GetProductId();
     string _side;
     switch (side)
     {
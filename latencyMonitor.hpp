@@ -0,0 +1,288 @@
+
+#ifndef LatencyMonitor_HPP
+#define LatencyMonitor_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include "soa.hpp"
+
+/**
+ * Histogram of latencies in nanoseconds with HDR-style log-linear buckets.
+ * Values below 2^kSubBucketBits get a bucket each, above that every power of
+ * two is split into 2^(kSubBucketBits - 1) buckets, so any recorded value is
+ * known within about 3%. Buckets are relaxed atomics, so any thread can record
+ * without a lock while another one reads.
+ */
+class LatencyHistogram
+{
+
+public:
+
+    static const unsigned kSubBucketBits = 5;
+    static const std::size_t kSubBucketCount = std::size_t(1) << kSubBucketBits;
+    static const std::size_t kHalfSubBucketCount = kSubBucketCount >> 1;
+    static const std::size_t kBucketCount = kSubBucketCount + (64 - kSubBucketBits) * kHalfSubBucketCount;
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator = (const LatencyHistogram&) = delete;
+
+    // Record one latency, negative values count as 0
+    void Record(std::int64_t nanoseconds);
+
+    // Get the number of recorded values
+    std::uint64_t GetCount() const;
+
+    // Get the largest recorded value
+    std::int64_t GetMax() const;
+
+    // Get the value below which the given fraction of recorded values fall
+    std::int64_t GetPercentile(double fraction) const;
+
+    // Forget every recorded value
+    void Reset();
+
+private:
+    // Bucket holding a value
+    static std::size_t BucketOf(std::uint64_t value);
+
+    // Largest value a bucket holds
+    static std::uint64_t BucketUpperBound(std::size_t bucket);
+
+    std::atomic<std::uint64_t> counts_[kBucketCount];
+    std::atomic<std::uint64_t> total_;
+    std::atomic<std::int64_t> max_;
+
+};
+
+/**
+ * Per-edge latency histograms of the service graph.
+ * Connectors stamp each message with its ingress time on the thread that reads it,
+ * TimedListeners record the time elapsed since that stamp when the message crosses
+ * their edge. Comparing consecutive edges shows where the time goes.
+ */
+class LatencyMonitor
+{
+
+public:
+
+    // Add an edge, the histogram stays valid for the life of the monitor
+    LatencyHistogram& AddEdge(const std::string& name);
+
+    // Write p50/p99/p99.9/max of every edge, in microseconds
+    void Dump(std::ostream& out) const;
+
+    // Forget every recorded value
+    void Reset();
+
+private:
+    // deque keeps histograms in place as edges are added
+    std::deque<std::pair<std::string, LatencyHistogram>> edges_;
+
+};
+
+/**
+ * Listener recording the latency of the edge it sits on, then forwarding downstream.
+ * Type V is the data type, type L the concrete downstream listener.
+ */
+template<typename V, typename L>
+class TimedListener final : public ServiceListener<V>
+{
+
+public:
+
+    // ctor for an edge into the downstream listener
+    TimedListener(LatencyHistogram& histogram, L* downstream);
+
+    // Listener callback to process an add event to the Service
+    virtual void ProcessAdd(V &data) override;
+
+    // Listener callback to process a remove event to the Service
+    virtual void ProcessRemove(V &data) override;
+
+    // Listener callback to process an update event to the Service
+    virtual void ProcessUpdate(V &data) override;
+
+private:
+    LatencyHistogram* histogram_;
+    L* downstream_;
+
+};
+
+// Time an edge into a listener, the value type is the listener's
+template<typename L>
+TimedListener<typename L::ValueType, L> MakeTimedListener(LatencyMonitor& monitor, const std::string& name, L* downstream);
+
+// Current time on a monotonic clock, in nanoseconds
+std::int64_t NowNanoseconds();
+
+// Stamp the message being read on this thread as entering the system now
+void StampIngress();
+
+// Get the ingress time of the message being processed on this thread
+std::int64_t GetIngressTime();
+
+// Carry an ingress time over to this thread, for messages handed across threads
+void SetIngressTime(std::int64_t ingress);
+
+// Ingress time of the message this thread is processing
+thread_local std::int64_t tls_ingress_time = 0;
+
+LatencyHistogram::LatencyHistogram() : total_(0), max_(0)
+{
+    for (auto& count : counts_) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::size_t LatencyHistogram::BucketOf(std::uint64_t value)
+{
+    if (value < kSubBucketCount) return std::size_t(value);
+
+    unsigned exponent = unsigned(64 - __builtin_clzll(value)) - kSubBucketBits;
+    std::size_t sub_bucket = std::size_t(value >> exponent) - kHalfSubBucketCount;
+    return kSubBucketCount + (exponent - 1) * kHalfSubBucketCount + sub_bucket;
+}
+
+std::uint64_t LatencyHistogram::BucketUpperBound(std::size_t bucket)
+{
+    if (bucket < kSubBucketCount) return bucket;
+
+    std::size_t offset = bucket - kSubBucketCount;
+    unsigned exponent = unsigned(offset / kHalfSubBucketCount) + 1;
+    std::uint64_t sub_bucket = (offset % kHalfSubBucketCount) + kHalfSubBucketCount;
+    return ((sub_bucket + 1) << exponent) - 1;
+}
+
+void LatencyHistogram::Record(std::int64_t nanoseconds)
+{
+    if (nanoseconds < 0) nanoseconds = 0;
+    counts_[BucketOf(std::uint64_t(nanoseconds))].fetch_add(1, std::memory_order_relaxed);
+    total_.fetch_add(1, std::memory_order_relaxed);
+
+    std::int64_t max = max_.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !max_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {}
+}
+
+std::uint64_t LatencyHistogram::GetCount() const
+{
+    return total_.load(std::memory_order_relaxed);
+}
+
+std::int64_t LatencyHistogram::GetMax() const
+{
+    return max_.load(std::memory_order_relaxed);
+}
+
+std::int64_t LatencyHistogram::GetPercentile(double fraction) const
+{
+    std::uint64_t total = this->GetCount();
+    if (total == 0) return 0;
+
+    std::uint64_t rank = std::uint64_t(fraction * double(total));
+    if (rank == 0) rank = 1;
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < kBucketCount; bucket++) {
+        seen += counts_[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            std::int64_t bound = std::int64_t(BucketUpperBound(bucket));
+            std::int64_t max = this->GetMax();
+            return bound < max ? bound : max;
+        }
+    }
+    return this->GetMax();
+}
+
+void LatencyHistogram::Reset()
+{
+    for (auto& count : counts_) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    total_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+LatencyHistogram& LatencyMonitor::AddEdge(const std::string& name)
+{
+    edges_.emplace_back(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple());
+    return edges_.back().second;
+}
+
+void LatencyMonitor::Dump(std::ostream& out) const
+{
+    auto micros = [](std::int64_t nanoseconds) { return double(nanoseconds) / 1000.; };
+
+    out << std::left << std::setw(40) << "edge (latency since ingress, us)" << std::right
+        << std::setw(12) << "count" << std::setw(10) << "p50" << std::setw(10) << "p99"
+        << std::setw(10) << "p99.9" << std::setw(10) << "max" << std::endl;
+    out << std::fixed << std::setprecision(2);
+    for (const auto& [name, histogram] : edges_) {
+        out << std::left << std::setw(40) << name << std::right
+            << std::setw(12) << histogram.GetCount()
+            << std::setw(10) << micros(histogram.GetPercentile(0.5))
+            << std::setw(10) << micros(histogram.GetPercentile(0.99))
+            << std::setw(10) << micros(histogram.GetPercentile(0.999))
+            << std::setw(10) << micros(histogram.GetMax()) << std::endl;
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+void LatencyMonitor::Reset()
+{
+    for (auto& edge : edges_) {
+        edge.second.Reset();
+    }
+}
+
+template<typename V, typename L>
+TimedListener<V, L>::TimedListener(LatencyHistogram& histogram, L* downstream) :
+    histogram_(&histogram), downstream_(downstream) {}
+
+template<typename V, typename L>
+void TimedListener<V, L>::ProcessAdd(V &data) {
+    histogram_->Record(NowNanoseconds() - GetIngressTime());
+    downstream_->ProcessAdd(data);
+}
+
+template<typename V, typename L>
+void TimedListener<V, L>::ProcessRemove(V &data) {
+    histogram_->Record(NowNanoseconds() - GetIngressTime());
+    downstream_->ProcessRemove(data);
+}
+
+template<typename V, typename L>
+void TimedListener<V, L>::ProcessUpdate(V &data) {
+    histogram_->Record(NowNanoseconds() - GetIngressTime());
+    downstream_->ProcessUpdate(data);
+}
+
+template<typename L>
+TimedListener<typename L::ValueType, L> MakeTimedListener(LatencyMonitor& monitor, const std::string& name, L* downstream) {
+    return TimedListener<typename L::ValueType, L>(monitor.AddEdge(name), downstream);
+}
+
+std::int64_t NowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void StampIngress() {
+    tls_ingress_time = NowNanoseconds();
+}
+
+std::int64_t GetIngressTime() {
+    return tls_ingress_time;
+}
+
+void SetIngressTime(std::int64_t ingress) {
+    tls_ingress_time = ingress;
+}
+
+#endif
@@ -0,0 +1,151 @@
+
+#ifndef LzBlock_HPP
+#define LzBlock_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * In-tree block compressor in the style of LZ4.
+ * A block is a run of sequences, each one a token byte (literal length in the
+ * high nibble, match length - 4 in the low nibble), extra length bytes for
+ * nibbles saturated at 15, the literals, then a 2 byte little endian match offset.
+ * The last sequence carries literals only. Matches are found through a single
+ * hash probe per position, which favours speed over ratio.
+ */
+
+const std::size_t kLzMinMatch = 4;
+const std::size_t kLzLastLiterals = 5;
+const std::size_t kLzMaxOffset = 65535;
+const unsigned kLzHashBits = 12;
+
+// Compress a range and append the block to out, returns the number of bytes appended
+std::size_t LzCompress(const char* source, std::size_t size, std::string& out);
+
+// Decompress a block into exactly raw_size bytes at destination, returns false on a malformed block
+bool LzDecompress(const char* source, std::size_t size, char* destination, std::size_t raw_size);
+
+// Hash of the 4 bytes starting a candidate match
+inline std::size_t LzHash(std::uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - kLzHashBits);
+}
+
+// Append a length saturated past its nibble as a run of 255s and a remainder
+inline void LzWriteLength(std::string& out, std::size_t length)
+{
+    while (length >= 255) {
+        out.push_back(char(255));
+        length -= 255;
+    }
+    out.push_back(char(length));
+}
+
+// Append one sequence, match_length 0 marks the final literals-only sequence
+inline void LzWriteSequence(std::string& out, const char* literals, std::size_t literal_length, std::size_t offset, std::size_t match_length)
+{
+    std::size_t match_code = (match_length == 0) ? 0 : match_length - kLzMinMatch;
+    unsigned char token = static_cast<unsigned char>(((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15));
+    out.push_back(char(token));
+    if (literal_length >= 15) {
+        LzWriteLength(out, literal_length - 15);
+    }
+    out.append(literals, literal_length);
+    if (match_length == 0) return;
+
+    out.push_back(char(offset & 0xFF));
+    out.push_back(char(offset >> 8));
+    if (match_code >= 15) {
+        LzWriteLength(out, match_code - 15);
+    }
+}
+
+// Read a length continuing past a saturated nibble, returns false past the end of the block
+inline bool LzReadLength(const unsigned char*& in, const unsigned char* end, std::size_t& length)
+{
+    unsigned char byte = 255;
+    while (byte == 255) {
+        if (in >= end) return false;
+        byte = *in++;
+        length += byte;
+    }
+    return true;
+}
+
+std::size_t LzCompress(const char* source, std::size_t size, std::string& out)
+{
+    std::size_t start = out.size();
+    // Holds position + 1 of the last occurrence of each hash, 0 when unseen
+    std::uint32_t table[std::size_t(1) << kLzHashBits] = {};
+
+    std::size_t anchor = 0;
+    std::size_t pos = 0;
+    std::size_t match_limit = (size > kLzLastLiterals) ? size - kLzLastLiterals : 0;
+    while (pos + kLzMinMatch <= match_limit) {
+        std::uint32_t sequence;
+        std::memcpy(&sequence, source + pos, sizeof(sequence));
+        std::size_t hash = LzHash(sequence);
+        std::size_t candidate = table[hash];
+        table[hash] = std::uint32_t(pos + 1);
+
+        if (candidate == 0 || pos - (candidate - 1) > kLzMaxOffset
+            || std::memcmp(source + candidate - 1, source + pos, kLzMinMatch) != 0) {
+            pos++;
+            continue;
+        }
+
+        candidate--;
+        std::size_t length = kLzMinMatch;
+        while (pos + length < match_limit && source[candidate + length] == source[pos + length]) {
+            length++;
+        }
+        LzWriteSequence(out, source + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+
+    LzWriteSequence(out, source + anchor, size - anchor, 0, 0);
+    return out.size() - start;
+}
+
+bool LzDecompress(const char* source, std::size_t size, char* destination, std::size_t raw_size)
+{
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(source);
+    const unsigned char* end = in + size;
+    std::size_t out = 0;
+
+    while (in < end) {
+        unsigned char token = *in++;
+
+        std::size_t literal_length = token >> 4;
+        if (literal_length == 15 && !LzReadLength(in, end, literal_length)) return false;
+        if (literal_length > std::size_t(end - in) || literal_length > raw_size - out) return false;
+        std::memcpy(destination + out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+
+        // The final sequence has no match
+        if (in == end) break;
+
+        if (end - in < 2) return false;
+        std::size_t offset = std::size_t(in[0]) | (std::size_t(in[1]) << 8);
+        in += 2;
+        std::size_t match_length = token & 0x0F;
+        if (match_length == 15 && !LzReadLength(in, end, match_length)) return false;
+        match_length += kLzMinMatch;
+        if (offset == 0 || offset > out || match_length > raw_size - out) return false;
+
+        // Byte by byte, a match may overlap the bytes it produces
+        const char* match = destination + out - offset;
+        for (std::size_t i = 0; i < match_length; i++) {
+            destination[out + i] = match[i];
+        }
+        out += match_length;
+    }
+
+    return out == raw_size;
+}
+
+#endif
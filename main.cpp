@@ -16,15 +16,61 @@
 #include "historicalDataService.hpp"
 #include "inquiryService.hpp"
 #include "guiService.hpp"
+#include "marketDataFeed.hpp"
+#include "pipelineStage.hpp"
+#include "latencyMonitor.hpp"
+#include "replayDriver.hpp"
+#include "shardedIngestion.hpp"
+#include "scenarioRisk.hpp"
+#include "curveService.hpp"
+#include <string>
+#include <thread>
 
 
-int main() {
+int main(int argc, char* argv[]) {
+    
+    // --threaded runs each feed and each downstream stage on its own pinned thread
+    // --columnar and --columnar-lz persist historical data as binary columns instead of text
+    // --binary-market-data reads the binary feed marketdata.bin instead of marketdata.txt
+    // --replay[=speed] merges the timestamped *.capture files by time and replays them
+    //   at speed times the recorded pacing, as fast as possible without a speed
+    // --sharded[=N] parses each file on a pool of parser threads and processes prices on
+    //   N product shards (one per cpu by default), implies --threaded
+    bool threaded = false;
+    bool sharded = false;
+    std::size_t shard_count = 0;
+    bool binary_market_data = false;
+    bool replay = false;
+    double replay_speed = 0.;
+    StoreFormat store_format = TEXT_STORE;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--threaded") threaded = true;
+        else if (arg == "--columnar") store_format = COLUMNAR_STORE;
+        else if (arg == "--columnar-lz") store_format = COMPRESSED_COLUMNAR_STORE;
+        else if (arg == "--binary-market-data") binary_market_data = true;
+        else if (arg == "--replay") replay = true;
+        else if (arg.rfind("--replay=", 0) == 0) {
+            replay = true;
+            replay_speed = std::stod(arg.substr(9));
+        }
+        else if (arg == "--sharded") sharded = true;
+        else if (arg.rfind("--sharded=", 0) == 0) {
+            sharded = true;
+            shard_count = std::stoul(arg.substr(10));
+        }
+    }
+    int cpu_count = std::max(1u, std::thread::hardware_concurrency());
+    if (sharded) threaded = true;
+    if (shard_count == 0) shard_count = std::size_t(cpu_count);
+    auto cpu = [&](int index) { return threaded ? index % cpu_count : -1; };
     
     std::cout << " Services Initializing..." << std::endl;
     PricingService<Bond> pricing_service;
     TradeBookingService<Bond> trade_booking_service;
     PositionService<Bond> position_service;
     RiskService<Bond> risk_service;
+    CurveService<Bond> curve_service("UST", MakeTreasuryBenchmarks());
     MarketDataService<Bond> market_data_service;
     AlgoExecutionService<Bond> algo_execution_service;
     AlgoStreamingService<Bond> algo_streaming_service;
@@ -32,49 +78,234 @@ int main() {
     ExecutionService<Bond> execution_service;
     StreamingService<Bond> streaming_service;
     InquiryService<Bond> inquiry_service;
-    HistoricalDataService<Position<Bond>> historical_position_service(POSITION);
-    HistoricalDataService<PV01<Bond>> historical_risk_service(RISK);
-    HistoricalDataService<ExecutionOrder<Bond>> historical_execution_service(EXECUTION);
-    HistoricalDataService<PriceStream<Bond>> historical_streaming_service(STREAMING);
-    HistoricalDataService<Inquiry<Bond>> historical_inquiry_service(INQUIRY);
+    HistoricalDataService<Position<Bond>> historical_position_service(POSITION, WriterPolicy(), store_format);
+    HistoricalDataService<PV01<Bond>> historical_risk_service(RISK, WriterPolicy(), store_format);
+    HistoricalDataService<ExecutionOrder<Bond>> historical_execution_service(EXECUTION, WriterPolicy(), store_format);
+    HistoricalDataService<PriceStream<Bond>> historical_streaming_service(STREAMING, WriterPolicy(), store_format);
+    HistoricalDataService<Inquiry<Bond>> historical_inquiry_service(INQUIRY, WriterPolicy(), store_format);
+
+    // Scenario risk on a key rate per on-the-run bond from its sensitivities at par,
+    // recomputed on its own threads after trades
+    std::vector<double> key_rate_tenors;
+    for (const auto& [maturity, bond] : kBondMapMaturity) key_rate_tenors.push_back(maturity);
+    ScenarioRiskEngine<Bond> scenario_risk_engine(key_rate_tenors, threaded ? std::size_t(cpu_count - 1) : 0);
+    BondAnalytics<Bond> analytics(kSettlementDate);
+    for (const auto& [maturity, bond] : kBondMapMaturity) {
+        ProductHandle product = FetchBondHandle(bond.first);
+        const BondRisk& risk = analytics.GetRisk(product, Ticks256(100 * Ticks256::kTicksPerPoint));
+        scenario_risk_engine.AddProduct(product, maturity, risk.pv01, risk.gamma);
+    }
+    scenario_risk_engine.SetScenarios(MakeShockGrid(50., 21));
+    PositionToScenarioRiskListener<Bond> scenario_risk_listener(&scenario_risk_engine);
 
     std::cout << " Services Linking..." << std::endl;
-    pricing_service.AddListener(algo_streaming_service.GetInListener());
-    pricing_service.AddListener(gui_service.GetInListener());
-    algo_streaming_service.AddListener(streaming_service.GetInListener());
-    streaming_service.AddListener(historical_streaming_service.GetInListener());
-    market_data_service.AddListener(algo_execution_service.GetInListener());
-    algo_execution_service.AddListener(execution_service.GetInListener());
-    execution_service.AddListener(trade_booking_service.GetInListener());
-    execution_service.AddListener(historical_execution_service.GetInListener());
-    trade_booking_service.AddListener(position_service.GetInListener());
-    position_service.AddListener(risk_service.GetInListener());
-    position_service.AddListener(historical_position_service.GetInListener());
-    risk_service.AddListener(historical_risk_service.GetInListener());
-    inquiry_service.AddListener(historical_inquiry_service.GetInListener());
+    // Every edge of the graph records the latency since its message entered the system
+    LatencyMonitor latency_monitor;
+    auto pricing_to_algo_streaming = MakeTimedListener(latency_monitor, "pricing->algo_streaming", algo_streaming_service.GetInListener());
+    auto pricing_to_risk = MakeTimedListener(latency_monitor, "pricing->risk", risk_service.GetPriceListener());
+    auto pricing_to_curve = MakeTimedListener(latency_monitor, "pricing->curve", curve_service.GetInListener());
+    auto pricing_to_gui = MakeTimedListener(latency_monitor, "pricing->gui", gui_service.GetInListener());
+    auto algo_streaming_to_streaming = MakeTimedListener(latency_monitor, "algo_streaming->streaming", streaming_service.GetInListener());
+    auto streaming_to_historical = MakeTimedListener(latency_monitor, "streaming->historical", historical_streaming_service.GetInListener());
+    auto market_data_to_algo_execution = MakeTimedListener(latency_monitor, "market_data->algo_execution", algo_execution_service.GetInListener());
+    auto algo_execution_to_execution = MakeTimedListener(latency_monitor, "algo_execution->execution", execution_service.GetInListener());
+    auto execution_to_trade_booking = MakeTimedListener(latency_monitor, "execution->trade_booking", trade_booking_service.GetInListener());
+    auto execution_to_historical = MakeTimedListener(latency_monitor, "execution->historical", historical_execution_service.GetInListener());
+    auto trade_booking_to_position = MakeTimedListener(latency_monitor, "trade_booking->position", position_service.GetInListener());
+    auto position_to_risk = MakeTimedListener(latency_monitor, "position->risk", risk_service.GetInListener());
+    auto position_to_scenario_risk = MakeTimedListener(latency_monitor, "position->scenario_risk", &scenario_risk_listener);
+    auto position_to_historical = MakeTimedListener(latency_monitor, "position->historical", historical_position_service.GetInListener());
+    auto risk_to_historical = MakeTimedListener(latency_monitor, "risk->historical", historical_risk_service.GetInListener());
+    auto inquiry_to_historical = MakeTimedListener(latency_monitor, "inquiry->historical", historical_inquiry_service.GetInListener());
+
+    // Persistence and the GUI sit behind SPSC rings so they never block the feeds in threaded mode,
+    // without a stage each StageListener simply forwards on the calling thread
+    PipelineStage persistence_stage("persistence", cpu(0));
+    PipelineStage gui_stage("gui", cpu(1));
+    PipelineStage* persistence = threaded ? &persistence_stage : nullptr;
+    // Price shards each produce into their own ring of the price path stages
+    std::size_t price_producers = sharded ? shard_count : 1;
+    StageListener<Price<Bond>> gui_in(&pricing_to_gui, threaded ? &gui_stage : nullptr, 4096, price_producers);
+    StageListener<PriceStream<Bond>> historical_streaming_in(&streaming_to_historical, persistence, 4096, price_producers);
+    StageListener<ExecutionOrder<Bond>> historical_execution_in(&execution_to_historical, persistence);
+    StageListener<Position<Bond>> historical_position_in(&position_to_historical, persistence);
+    StageListener<PV01<Bond>> historical_risk_in(&risk_to_historical, persistence);
+    StageListener<Inquiry<Bond>> historical_inquiry_in(&inquiry_to_historical, persistence);
+
+    // The service graph is fixed, so each service fans out through a compile-time chain of its
+    // listeners, one virtual call into the chain instead of one per listener
+    auto pricing_listeners = MakeListenerChain(&pricing_to_algo_streaming, &pricing_to_risk, &pricing_to_curve, &gui_in);
+    auto algo_streaming_listeners = MakeListenerChain(&algo_streaming_to_streaming);
+    auto streaming_listeners = MakeListenerChain(&historical_streaming_in);
+    auto market_data_listeners = MakeListenerChain(&market_data_to_algo_execution);
+    auto algo_execution_listeners = MakeListenerChain(&algo_execution_to_execution);
+    auto execution_listeners = MakeListenerChain(&execution_to_trade_booking, &historical_execution_in);
+    auto trade_booking_listeners = MakeListenerChain(&trade_booking_to_position);
+    auto position_listeners = MakeListenerChain(&position_to_risk, &position_to_scenario_risk, &historical_position_in);
+    auto risk_listeners = MakeListenerChain(&historical_risk_in);
+    auto inquiry_listeners = MakeListenerChain(&historical_inquiry_in);
+
+    pricing_service.AddListener(&pricing_listeners);
+    algo_streaming_service.AddListener(&algo_streaming_listeners);
+    streaming_service.AddListener(&streaming_listeners);
+    market_data_service.AddListener(&market_data_listeners);
+    algo_execution_service.AddListener(&algo_execution_listeners);
+    execution_service.AddListener(&execution_listeners);
+    trade_booking_service.AddListener(&trade_booking_listeners);
+    position_service.AddListener(&position_listeners);
+    risk_service.AddListener(&risk_listeners);
+    inquiry_service.AddListener(&inquiry_listeners);
+    std::vector<BucketedSector<Bond>> sectors = MakeTreasurySectors();
+    for (const auto& sector : sectors) {
+        risk_service.AddBucketedSector(sector);
+    }
+    scenario_risk_engine.Start();
     std::cout << " Services Linked." << std::endl;
 
-    // Process Price Data
-    std::cout << "Price Data Processing..." << std::endl;
-    std::ifstream price_data("prices.txt");
-    pricing_service.GetConnector()->Subscribe(price_data);
+    // Sharded ingestion parses on every cpu. Only the price path keeps its state per product,
+    // the trade, market data and inquiry paths share state across products so they keep one shard
+    std::size_t parser_count = std::size_t(cpu_count);
 
-    // Process Trade Data
-    std::cout << "Trade Data Processing..." << std::endl;
-    std::ifstream trade_data("trades.txt");
-    trade_booking_service.GetConnector()->Subscribe(trade_data);
+    // Process Price Data
+    auto process_prices = [&]() {
+        MappedFile price_data("prices.txt");
+        if (sharded) {
+            PricingConnector<Bond>* connector = pricing_service.GetConnector();
+            ShardedIngestor<Price<Bond>> ingestor(parser_count, shard_count);
+            ingestor.Ingest(price_data.GetView(),
+                [&](std::string_view line, Price<Bond>& price) { price = connector->Parse(line); return price.GetProductHandle(); },
+                [&](Price<Bond>& price) { pricing_service.OnMessage(std::move(price)); });
+        } else {
+            pricing_service.GetConnector()->Subscribe(price_data);
+        }
+    };
 
-    // Process Market Data
-    std::cout << "Market Data Processing..." << std::endl;
-    std::ifstream market_data("marketdata.txt");
-    market_data_service.GetConnector()->Subscribe(market_data);
+    // Process Trade Data, then Market Data
+    // Both feed the trade booking service, so they share a thread
+    auto process_trades = [&]() {
+        MappedFile trade_data("trades.txt");
+        if (sharded) {
+            TradeBookingConnector<Bond>* connector = trade_booking_service.GetConnector();
+            ShardedIngestor<Trade<Bond>> ingestor(parser_count, 1);
+            ingestor.Ingest(trade_data.GetView(),
+                [&](std::string_view line, Trade<Bond>& trade) { trade = connector->Parse(line); return trade.GetProductHandle(); },
+                [&](Trade<Bond>& trade) { trade_booking_service.OnMessage(std::move(trade)); });
+        } else {
+            trade_booking_service.GetConnector()->Subscribe(trade_data);
+        }
+    };
+    BinaryMarketDataConnector<Bond> binary_market_data_connector(&market_data_service);
+    auto process_market_data = [&]() {
+        if (binary_market_data) {
+            MappedFile market_data("marketdata.bin");
+            binary_market_data_connector.Subscribe(market_data);
+        } else if (sharded) {
+            // A record is one whole snapshot, both sides of the book
+            MappedFile market_data("marketdata.txt");
+            MarketDataConnector<Bond>* connector = market_data_service.GetConnector();
+            ShardedIngestor<OrderBookSnapshot> ingestor(parser_count, 1, 2 * std::size_t(market_data_service.GetBookDepth()));
+            ingestor.Ingest(market_data.GetView(),
+                [&](std::string_view lines, OrderBookSnapshot& snapshot) { connector->ParseSnapshot(lines, snapshot); return snapshot.product; },
+                [&](OrderBookSnapshot& snapshot) { market_data_service.OnSnapshot(snapshot.product, snapshot.bids, snapshot.offers); });
+        } else {
+            MappedFile market_data("marketdata.txt");
+            market_data_service.GetConnector()->Subscribe(market_data);
+        }
+    };
 
     // Process Inquiry Data
-    std::cout << "Inquiry Data Processing..." << std::endl;
-    std::ifstream inquiry_data("inquiries.txt");
-    inquiry_service.GetConnector()->Subscribe(inquiry_data);
+    auto process_inquiries = [&]() {
+        MappedFile inquiry_data("inquiries.txt");
+        if (sharded) {
+            InquiryConnector<Bond>* connector = inquiry_service.GetConnector();
+            ShardedIngestor<Inquiry<Bond>> ingestor(parser_count, 1);
+            ingestor.Ingest(inquiry_data.GetView(),
+                [&](std::string_view line, Inquiry<Bond>& inquiry) { inquiry = connector->Parse(line); return inquiry.GetProductHandle(); },
+                [&](Inquiry<Bond>& inquiry) { inquiry_service.OnMessage(std::move(inquiry)); });
+        } else {
+            inquiry_service.GetConnector()->Subscribe(inquiry_data);
+        }
+    };
+
+    // Replay captured feeds merged by time, on this thread
+    auto process_captures = [&]() {
+        MappedFile price_capture("prices.capture");
+        MappedFile trade_capture("trades.capture");
+        MappedFile market_data_capture("marketdata.capture");
+        MappedFile inquiry_capture("inquiries.capture");
+        ReplayDriver driver(replay_speed);
+        driver.AddFeed("prices", price_capture.GetView(),
+            [&](std::string_view line) { pricing_service.GetConnector()->ParseLine(line); });
+        driver.AddFeed("trades", trade_capture.GetView(),
+            [&](std::string_view line) { trade_booking_service.GetConnector()->ParseLine(line); });
+        driver.AddFeed("market data", market_data_capture.GetView(),
+            [&](std::string_view line) { market_data_service.GetConnector()->ParseLine(line); });
+        driver.AddFeed("inquiries", inquiry_capture.GetView(),
+            [&](std::string_view line) { inquiry_service.GetConnector()->ParseLine(line); });
+        driver.Run();
+        driver.Report(std::cout);
+    };
+
+    if (replay) {
+        std::cout << "Captured Data Replaying..." << std::endl;
+        if (threaded) {
+            persistence_stage.Start();
+            gui_stage.Start();
+        }
+        process_captures();
+        gui_stage.Stop();
+        persistence_stage.Stop();
+    } else if (threaded) {
+        std::cout << "Price, Trade, Market and Inquiry Data Processing concurrently..." << std::endl;
+        persistence_stage.Start();
+        gui_stage.Start();
+
+        std::thread price_feed([&]() { PinCurrentThread(cpu(2)); process_prices(); });
+        std::thread trade_feed([&]() { PinCurrentThread(cpu(3)); process_trades(); process_market_data(); });
+        std::thread inquiry_feed([&]() { PinCurrentThread(cpu(4)); process_inquiries(); });
+        price_feed.join();
+        trade_feed.join();
+        inquiry_feed.join();
+
+        // Feeds are done, let the stages drain
+        gui_stage.Stop();
+        persistence_stage.Stop();
+    } else {
+        std::cout << "Price Data Processing..." << std::endl;
+        process_prices();
+
+        std::cout << "Trade Data Processing..." << std::endl;
+        process_trades();
+
+        std::cout << "Market Data Processing..." << std::endl;
+        process_market_data();
+
+        std::cout << "Inquiry Data Processing..." << std::endl;
+        process_inquiries();
+    }
 
     // Complete Trades
     std::cout << "Completed" << std::endl;
+    if (auto curve = curve_service.GetCurve()) {
+        std::cout << "Curve " << curve->GetName() << " after " << curve->GetVersion() << " rebuilds" << std::endl;
+        std::size_t point = 0;
+        for (const auto& [maturity, bond] : kBondMapMaturity) {
+            double tenor = curve->GetTenors()[point];
+            std::cout << "  " << maturity << "Y par " << 100. * curve->GetParYields()[point++] << "%, zero "
+                << 100. * curve->GetZeroRate(tenor) << "%, fair price " << curve_service.GetFairPrice(FetchBondHandle(bond.first)) << std::endl;
+        }
+    }
+    scenario_risk_engine.Stop();
+    auto scenario_risk = scenario_risk_engine.GetSnapshot();
+    if (!scenario_risk->scenario_pnl.empty()) {
+        CurveScenario worst = scenario_risk_engine.GetScenario(scenario_risk->worst_scenario);
+        std::cout << "Portfolio PV01: " << scenario_risk->portfolio_pv01 << ", worst of " << scenario_risk_engine.GetScenarioCount()
+            << " scenarios: " << scenario_risk->scenario_pnl[scenario_risk->worst_scenario] << " (parallel " << worst.parallel
+            << "bp, twist " << worst.twist << "bp, butterfly " << worst.butterfly << "bp)" << std::endl;
+    }
+    for (const auto& sector : sectors) {
+        std::cout << "Bucketed risk " << sector.GetName() << ": " << risk_service.GetBucketedRisk(sector).GetPV01() << std::endl;
+    }
+    latency_monitor.Dump(std::cout);
 
 }
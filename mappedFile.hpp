@@ -0,0 +1,160 @@
+
+#ifndef MappedFile_HPP
+#define MappedFile_HPP
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Read-only memory mapping of an input file.
+ * Connectors read lines straight out of the mapping as string_views,
+ * so no per-line buffer is allocated while parsing.
+ * A file that cannot be opened maps to an empty view, the same way
+ * an ifstream that failed to open simply yields no lines.
+ */
+class MappedFile
+{
+
+public:
+
+    // ctor mapping the file at the given path
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    // Whether the file has been mapped
+    bool IsOpen() const;
+
+    // Get the size of the file in bytes
+    std::size_t GetSize() const;
+
+    // Get the whole file as a character range
+    std::string_view GetView() const;
+
+private:
+    const char* data_;
+    std::size_t size_;
+    bool is_open_;
+
+};
+
+/**
+ * Walks over the lines of a character range without copying them.
+ * Trailing '\r' is stripped so that files with CRLF endings parse the same.
+ */
+class LineReader
+{
+
+public:
+
+    // ctor over a character range
+    LineReader(std::string_view data);
+
+    // Fetch the next line, returns false once the range is exhausted
+    bool Next(std::string_view& line);
+
+private:
+    std::string_view data_;
+    std::size_t pos_;
+
+};
+
+// Split a line on the delimiter into at most max_fields views, returns the number of fields
+std::size_t SplitLine(std::string_view line, std::string_view* fields, std::size_t max_fields, char delimiter = ',');
+
+MappedFile::MappedFile(const std::string& path) : data_(nullptr), size_(0), is_open_(false)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) == 0) {
+        is_open_ = true;
+        size_ = static_cast<std::size_t>(file_stat.st_size);
+        if (size_ > 0) {
+            void* address = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                is_open_ = false;
+                size_ = 0;
+            } else {
+                data_ = static_cast<const char*>(address);
+                // Input files are consumed front to back exactly once
+                ::madvise(address, size_, MADV_SEQUENTIAL);
+            }
+        }
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+bool MappedFile::IsOpen() const
+{
+    return this->is_open_;
+}
+
+std::size_t MappedFile::GetSize() const
+{
+    return this->size_;
+}
+
+std::string_view MappedFile::GetView() const
+{
+    return std::string_view(data_, size_);
+}
+
+LineReader::LineReader(std::string_view data) : data_(data), pos_(0) {}
+
+bool LineReader::Next(std::string_view& line)
+{
+    if (pos_ >= data_.size()) {
+        return false;
+    }
+
+    std::size_t end = data_.find('\n', pos_);
+    if (end == std::string_view::npos) {
+        end = data_.size();
+    }
+
+    line = data_.substr(pos_, end - pos_);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+
+    pos_ = end + 1;
+    return true;
+}
+
+std::size_t SplitLine(std::string_view line, std::string_view* fields, std::size_t max_fields, char delimiter)
+{
+    std::size_t count = 0;
+    std::size_t start = 0;
+    while (count < max_fields) {
+        std::size_t end = line.find(delimiter, start);
+        if (end == std::string_view::npos) {
+            fields[count++] = line.substr(start);
+            break;
+        }
+        fields[count++] = line.substr(start, end - start);
+        start = end + 1;
+    }
+    return count;
+}
+
+#endif
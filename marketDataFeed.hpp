@@ -0,0 +1,272 @@
+
+#ifndef MarketDataFeed_HPP
+#define MarketDataFeed_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "marketDataService.hpp"
+
+/**
+ * Compact binary wire format for order book snapshots and level deltas.
+ * File:     "TSMD", uint16 security count, then per security uint8 length and its cusip,
+ *           then a run of messages
+ * Message:  uint8 type, uint8 entry count, uint16 security index, then the entries
+ * Entry:    uint8 flags, int32 price in 1/256 ticks, int32 quantity (9 bytes)
+ *           flags bit 0 is the side (0 BID, 1 OFFER), bits 1-2 the LevelAction of a delta
+ * A snapshot lists the raw orders of both sides of a book, a delta lists level changes.
+ * Integers are in host byte order.
+ */
+
+enum FeedMessageType { FEED_SNAPSHOT = 1, FEED_DELTA = 2 };
+
+const char kFeedMagic[4] = { 'T', 'S', 'M', 'D' };
+const std::size_t kFeedMessageHeaderSize = 4;
+const std::size_t kFeedEntrySize = 9;
+const std::size_t kFeedMaxEntries = 255;
+
+/**
+ * Encoder appending feed messages to an in-memory buffer.
+ */
+class MarketDataEncoder
+{
+
+public:
+
+    // ctor writing the file header for the given securities, indexed in that order
+    MarketDataEncoder(const std::vector<std::string>& cusips);
+
+    // Append a snapshot of raw orders for a security
+    void AppendSnapshot(std::uint16_t security, const std::vector<Order>& orders);
+
+    // Append level deltas for a security
+    void AppendDeltas(std::uint16_t security, const LevelDelta* deltas, std::size_t count);
+
+    // Get the encoded bytes
+    const std::string& GetBuffer() const;
+
+    // Drop the encoded bytes, keeping the capacity
+    void Clear();
+
+private:
+    // Append the header of a message
+    void AppendHeader(FeedMessageType type, std::uint16_t security, std::size_t count);
+
+    // Append one entry
+    void AppendEntry(std::uint8_t flags, Ticks256 price, long quantity);
+
+    std::string buffer_;
+
+};
+
+/**
+ * Connector decoding the binary feed into MarketDataService.
+ * Snapshots go through OnSnapshot and deltas through OnDeltas, so the service
+ * updates its books in place either way.
+ * Type T is the product type.
+ */
+template<typename T>
+class BinaryMarketDataConnector : public Connector<OrderBook<T>>
+{
+
+public:
+
+    // ctor for a connector feeding the given service
+    BinaryMarketDataConnector(MarketDataService<T>* service);
+    ~BinaryMarketDataConnector() = default;
+
+    // Publish data to the Connector
+    // Does nothing
+    // BinaryMarketDataConnector is subscribe only
+    virtual void Publish(OrderBook<T>& data) override;
+
+    // Subscribe data from the Connector
+    virtual void Subscribe(ifstream& data) override;
+
+    // Subscribe data from a memory-mapped file
+    virtual void Subscribe(const MappedFile& data) override;
+
+    // Decode a whole feed, throws invalid_argument on a malformed one
+    void Decode(std::string_view data);
+
+    // Get the number of messages decoded so far
+    std::size_t GetMessageCount() const;
+
+private:
+    MarketDataService<T>* service_;
+    std::vector<ProductHandle> products_;
+    vector<Order> bid_stack_;
+    vector<Order> offer_stack_;
+    std::vector<LevelDelta> deltas_;
+    std::size_t message_count_;
+
+};
+
+MarketDataEncoder::MarketDataEncoder(const std::vector<std::string>& cusips)
+{
+    buffer_.append(kFeedMagic, sizeof(kFeedMagic));
+    std::uint16_t count = std::uint16_t(cusips.size());
+    buffer_.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const auto& cusip : cusips) {
+        buffer_.push_back(char(std::uint8_t(cusip.size())));
+        buffer_.append(cusip);
+    }
+}
+
+void MarketDataEncoder::AppendHeader(FeedMessageType type, std::uint16_t security, std::size_t count)
+{
+    if (count > kFeedMaxEntries) {
+        throw std::invalid_argument("MarketDataEncoder: too many entries in one message");
+    }
+    buffer_.push_back(char(type));
+    buffer_.push_back(char(std::uint8_t(count)));
+    buffer_.append(reinterpret_cast<const char*>(&security), sizeof(security));
+}
+
+void MarketDataEncoder::AppendEntry(std::uint8_t flags, Ticks256 price, long quantity)
+{
+    std::int32_t ticks = std::int32_t(price.GetTicks());
+    std::int32_t size = std::int32_t(quantity);
+    buffer_.push_back(char(flags));
+    buffer_.append(reinterpret_cast<const char*>(&ticks), sizeof(ticks));
+    buffer_.append(reinterpret_cast<const char*>(&size), sizeof(size));
+}
+
+void MarketDataEncoder::AppendSnapshot(std::uint16_t security, const std::vector<Order>& orders)
+{
+    this->AppendHeader(FEED_SNAPSHOT, security, orders.size());
+    for (const auto& order : orders) {
+        this->AppendEntry(std::uint8_t(order.GetSide()), order.GetPrice(), order.GetQuantity());
+    }
+}
+
+void MarketDataEncoder::AppendDeltas(std::uint16_t security, const LevelDelta* deltas, std::size_t count)
+{
+    this->AppendHeader(FEED_DELTA, security, count);
+    for (std::size_t i = 0; i < count; i++) {
+        std::uint8_t flags = std::uint8_t(deltas[i].side) | std::uint8_t(deltas[i].action << 1);
+        this->AppendEntry(flags, deltas[i].price, deltas[i].quantity);
+    }
+}
+
+const std::string& MarketDataEncoder::GetBuffer() const
+{
+    return this->buffer_;
+}
+
+void MarketDataEncoder::Clear()
+{
+    this->buffer_.clear();
+}
+
+template<typename T>
+BinaryMarketDataConnector<T>::BinaryMarketDataConnector(MarketDataService<T>* service) :
+    service_(service), message_count_(0) {}
+
+template<typename T>
+void BinaryMarketDataConnector<T>::Publish(OrderBook<T>& data) {
+    // Does nothing
+    // BinaryMarketDataConnector is subscribe only
+}
+
+template<typename T>
+void BinaryMarketDataConnector<T>::Subscribe(ifstream& data) {
+    std::string buffer((std::istreambuf_iterator<char>(data)), std::istreambuf_iterator<char>());
+    this->Decode(buffer);
+}
+
+template<typename T>
+void BinaryMarketDataConnector<T>::Subscribe(const MappedFile& data) {
+    this->Decode(data.GetView());
+}
+
+template<typename T>
+void BinaryMarketDataConnector<T>::Decode(std::string_view data) {
+    if (data.empty()) return;
+
+    const char* in = data.data();
+    const char* end = in + data.size();
+    if (data.size() < sizeof(kFeedMagic) + 2 || std::memcmp(in, kFeedMagic, sizeof(kFeedMagic)) != 0) {
+        throw std::invalid_argument("BinaryMarketDataConnector: not a market data feed");
+    }
+    in += sizeof(kFeedMagic);
+
+    // Resolve every security once, messages then carry its index
+    std::uint16_t security_count;
+    std::memcpy(&security_count, in, sizeof(security_count));
+    in += sizeof(security_count);
+    products_.clear();
+    for (std::uint16_t i = 0; i < security_count; i++) {
+        if (in >= end || std::size_t(end - in) < 1 + std::size_t(std::uint8_t(*in))) {
+            throw std::invalid_argument("BinaryMarketDataConnector: truncated security table");
+        }
+        std::size_t length = std::uint8_t(*in++);
+        products_.push_back(FetchBondHandle(std::string_view(in, length)));
+        in += length;
+    }
+
+    while (in < end) {
+        StampIngress();
+        if (std::size_t(end - in) < kFeedMessageHeaderSize) {
+            throw std::invalid_argument("BinaryMarketDataConnector: truncated message");
+        }
+        FeedMessageType type = FeedMessageType(std::uint8_t(in[0]));
+        std::size_t count = std::uint8_t(in[1]);
+        std::uint16_t security;
+        std::memcpy(&security, in + 2, sizeof(security));
+        in += kFeedMessageHeaderSize;
+        if (security >= products_.size() || std::size_t(end - in) < count * kFeedEntrySize) {
+            throw std::invalid_argument("BinaryMarketDataConnector: malformed message");
+        }
+
+        bid_stack_.clear();
+        offer_stack_.clear();
+        deltas_.clear();
+        for (std::size_t i = 0; i < count; i++, in += kFeedEntrySize) {
+            std::uint8_t flags = std::uint8_t(in[0]);
+            std::int32_t ticks;
+            std::int32_t quantity;
+            std::memcpy(&ticks, in + 1, sizeof(ticks));
+            std::memcpy(&quantity, in + 5, sizeof(quantity));
+            PricingSide side = (flags & 1) ? OFFER : BID;
+
+            if (type == FEED_SNAPSHOT) {
+                (side == BID ? bid_stack_ : offer_stack_).push_back(Order(Ticks256(ticks), quantity, side));
+            } else {
+                int action = (flags >> 1) & 3;
+                if (action > LEVEL_DELETE) {
+                    throw std::invalid_argument("BinaryMarketDataConnector: unknown level action");
+                }
+                LevelDelta delta;
+                delta.side = side;
+                delta.action = LevelAction(action);
+                delta.price = Ticks256(ticks);
+                delta.quantity = quantity;
+                deltas_.push_back(delta);
+            }
+        }
+
+        switch (type) {
+            case FEED_SNAPSHOT:
+                service_->OnSnapshot(products_[security], bid_stack_, offer_stack_);
+                break;
+            case FEED_DELTA:
+                service_->OnDeltas(products_[security], deltas_.data(), deltas_.size());
+                break;
+            default:
+                throw std::invalid_argument("BinaryMarketDataConnector: unknown message type");
+        }
+        message_count_++;
+    }
+}
+
+template<typename T>
+std::size_t BinaryMarketDataConnector<T>::GetMessageCount() const {
+    return this->message_count_;
+}
+
+#endif
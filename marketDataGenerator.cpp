@@ -0,0 +1,157 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "soa.hpp"
+#include "products.hpp"
+#include "utilities.hpp"
+#include "marketDataService.hpp"
+#include "marketDataFeed.hpp"
+
+/**
+ * Deterministic generator of a binary treasury market data feed.
+ * Usage: tradingsystem_mdgen [output (marketdata.bin)] [updates (1000000)] [seed (1)]
+ * Each of the seven on-the-run bonds starts from a full snapshot, then receives
+ * level deltas: mostly size changes near the top of the book, sometimes a one
+ * tick move of the whole book, and a fresh snapshot now and then.
+ * The same seed always produces the same file.
+ */
+
+const std::size_t kGeneratorDepth = 10;
+const std::size_t kSnapshotInterval = 1000;
+
+// Book of one bond as the generator sees it, levels best first
+struct GeneratedBook
+{
+    std::vector<PriceLevel> bids;
+    std::vector<PriceLevel> offers;
+};
+
+// Quantity resting at a level, whole millions growing away from the top
+long DrawQuantity(std::mt19937_64& generator, std::size_t depth) {
+    return 1000000 * long(1 + depth + generator() % 10);
+}
+
+// Lay out a fresh book around a mid, one or two ticks either side of it
+void ResetBook(GeneratedBook& book, long mid, long half_spread, std::mt19937_64& generator) {
+    book.bids.clear();
+    book.offers.clear();
+    for (std::size_t i = 0; i < kGeneratorDepth; i++) {
+        book.bids.push_back({ Ticks256(mid - half_spread - long(i)), DrawQuantity(generator, i) });
+        book.offers.push_back({ Ticks256(mid + half_spread + long(i)), DrawQuantity(generator, i) });
+    }
+}
+
+// Raw orders of a book as a snapshot
+std::vector<Order> ToOrders(const GeneratedBook& book) {
+    std::vector<Order> orders;
+    for (const auto& level : book.bids) orders.push_back(Order(level.price, level.quantity, BID));
+    for (const auto& level : book.offers) orders.push_back(Order(level.price, level.quantity, OFFER));
+    return orders;
+}
+
+// Level delta on one side of a book
+LevelDelta MakeDelta(PricingSide side, LevelAction action, const PriceLevel& level) {
+    LevelDelta delta;
+    delta.side = side;
+    delta.action = action;
+    delta.price = level.price;
+    delta.quantity = level.quantity;
+    return delta;
+}
+
+// Move the whole book one tick, up or down, as four level deltas
+void ShiftBook(GeneratedBook& book, bool is_up, std::mt19937_64& generator, std::vector<LevelDelta>& deltas) {
+    Ticks256 tick(1);
+    if (is_up) {
+        // A new best bid joins, the best offer is lifted, both ladders keep their depth
+        deltas.push_back(MakeDelta(BID, LEVEL_DELETE, book.bids.back()));
+        book.bids.pop_back();
+        book.bids.insert(book.bids.begin(), { book.bids.front().price + tick, DrawQuantity(generator, 0) });
+        deltas.push_back(MakeDelta(BID, LEVEL_ADD, book.bids.front()));
+
+        deltas.push_back(MakeDelta(OFFER, LEVEL_DELETE, book.offers.front()));
+        book.offers.erase(book.offers.begin());
+        book.offers.push_back({ book.offers.back().price + tick, DrawQuantity(generator, kGeneratorDepth - 1) });
+        deltas.push_back(MakeDelta(OFFER, LEVEL_ADD, book.offers.back()));
+    } else {
+        deltas.push_back(MakeDelta(OFFER, LEVEL_DELETE, book.offers.back()));
+        book.offers.pop_back();
+        book.offers.insert(book.offers.begin(), { book.offers.front().price - tick, DrawQuantity(generator, 0) });
+        deltas.push_back(MakeDelta(OFFER, LEVEL_ADD, book.offers.front()));
+
+        deltas.push_back(MakeDelta(BID, LEVEL_DELETE, book.bids.front()));
+        book.bids.erase(book.bids.begin());
+        book.bids.push_back({ book.bids.back().price - tick, DrawQuantity(generator, kGeneratorDepth - 1) });
+        deltas.push_back(MakeDelta(BID, LEVEL_ADD, book.bids.back()));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = (argc > 1) ? argv[1] : "marketdata.bin";
+    std::size_t updates = (argc > 2) ? std::size_t(std::strtoull(argv[2], nullptr, 10)) : 1000000;
+    std::uint64_t seed = (argc > 3) ? std::strtoull(argv[3], nullptr, 10) : 1;
+
+    std::vector<std::string> cusips;
+    for (const auto& [maturity, bond] : kBondMapMaturity) {
+        cusips.push_back(bond.first);
+    }
+
+    std::mt19937_64 generator(seed);
+    std::vector<GeneratedBook> books(cusips.size());
+    std::vector<long> half_spreads(cusips.size());
+    MarketDataEncoder encoder(cusips);
+
+    // Every book opens on a snapshot around par
+    for (std::size_t i = 0; i < books.size(); i++) {
+        long mid = 99 * Ticks256::kTicksPerPoint + long(generator() % Ticks256::kTicksPerPoint);
+        half_spreads[i] = 1 + long(generator() % 2);
+        ResetBook(books[i], mid, half_spreads[i], generator);
+        encoder.AppendSnapshot(std::uint16_t(i), ToOrders(books[i]));
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return 1;
+    }
+
+    std::vector<LevelDelta> deltas;
+    for (std::size_t update = 0; update < updates; update++) {
+        std::size_t security = std::size_t(generator() % books.size());
+        GeneratedBook& book = books[security];
+        std::uint64_t event = generator() % 100;
+
+        deltas.clear();
+        if (update % kSnapshotInterval == kSnapshotInterval - 1) {
+            // Periodic resync around the current mid
+            long mid = (book.bids.front().price.GetTicks() + book.offers.front().price.GetTicks()) / 2;
+            half_spreads[security] = 1 + long(generator() % 2);
+            ResetBook(book, mid, half_spreads[security], generator);
+            encoder.AppendSnapshot(std::uint16_t(security), ToOrders(book));
+        } else if (event < 70) {
+            // Size change near the top of one side
+            bool is_bid = generator() % 2;
+            std::vector<PriceLevel>& ladder = is_bid ? book.bids : book.offers;
+            std::size_t depth = std::size_t(generator() % 5);
+            ladder[depth].quantity = DrawQuantity(generator, depth);
+            deltas.push_back(MakeDelta(is_bid ? BID : OFFER, LEVEL_MODIFY, ladder[depth]));
+            encoder.AppendDeltas(std::uint16_t(security), deltas.data(), deltas.size());
+        } else {
+            ShiftBook(book, event % 2 == 0, generator, deltas);
+            encoder.AppendDeltas(std::uint16_t(security), deltas.data(), deltas.size());
+        }
+
+        // Stream the file out in large chunks
+        if (encoder.GetBuffer().size() >= (1 << 20)) {
+            file.write(encoder.GetBuffer().data(), std::streamsize(encoder.GetBuffer().size()));
+            encoder.Clear();
+        }
+    }
+    file.write(encoder.GetBuffer().data(), std::streamsize(encoder.GetBuffer().size()));
+
+    std::cout << "Generated " << updates << " updates for " << cusips.size() << " securities into " << path << std::endl;
+    return 0;
+}
@@ -2,20 +2,39 @@
 #ifndef MarketDataService_HPP
 #define MarketDataService_HPP
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <map>
-#include <unordered_map>
-#include <sstream>
-#include <string>
+#include <string_view>
 #include "soa.hpp"
 #include "utilities.hpp"
+#include "priceLadder.hpp"
+#include "latencyMonitor.hpp"
 
 using namespace std;
 
 // Side for market data
 enum PricingSide { BID, OFFER };
 
+// Change made to one price level of a book
+enum LevelAction { LEVEL_ADD, LEVEL_MODIFY, LEVEL_DELETE };
+
+// Maximum number of price levels kept per side of a book
+const std::size_t kMaxBookLevels = 32;
+
+/**
+ * Delta to one price level of a book.
+ * LEVEL_ADD adds quantity at the price, LEVEL_MODIFY sets it, LEVEL_DELETE removes the level.
+ */
+struct LevelDelta
+{
+    PricingSide side = BID;
+    LevelAction action = LEVEL_ADD;
+    Ticks256 price;
+    long quantity = 0;
+};
+
 /**
  * A market data order with price, quantity, and side.
  */
@@ -24,11 +43,12 @@ class Order
 
 public:
 
+    Order() = default;
     // ctor for an order
-    Order(double _price, long _quantity, PricingSide _side);
+    Order(Ticks256 _price, long _quantity, PricingSide _side);
 
     // Get the price on the order
-    double GetPrice() const;
+    Ticks256 GetPrice() const;
 
     // Get the quantity on the order
     long GetQuantity() const;
@@ -37,9 +57,9 @@ public:
     PricingSide GetSide() const;
 
 private:
-    double price;
-    long quantity;
-    PricingSide side;
+    Ticks256 price;
+    long quantity = 0;
+    PricingSide side = BID;
 
 };
 
@@ -51,6 +71,7 @@ class BidOffer
 
 public:
 
+    BidOffer() = default;
     // ctor for bid/offer
     BidOffer(const Order &_bidOrder, const Order &_offerOrder);
 
@@ -61,12 +82,14 @@ public:
     const Order& GetOfferOrder() const;
 
 private:
-    const Order& bidOrder;
-    const Order& offerOrder;
+    Order bidOrder;
+    Order offerOrder;
 };
 
 /**
- * Order book with a bid and offer stack.
+ * Order book with a bid and offer ladder of aggregated price levels.
+ * The book is updated in place by level deltas and remembers the deltas of the
+ * last update, so listeners can look at the changed levels only.
  * Type T is the product type.
  */
 template <typename T>
@@ -78,30 +101,59 @@ public:
     // ctor for the order book
     OrderBook() = default;  // Necessary for map operations
     OrderBook(const T &_product, const std::vector<Order> &_bidStack, const std::vector<Order> &_offerStack);
-    OrderBook(const T &_product, std::vector<Order>&& _bidStack, std::vector<Order>&& _offerStack);
+    OrderBook(ProductHandle _product, const std::vector<Order> &_bidStack, const std::vector<Order> &_offerStack);
+    OrderBook(ProductHandle _product);
 
     // Get the product
     const T& GetProduct() const;
 
-    // Get the bid stack
-    const std::vector<Order>& GetBidStack() const;
+    // Get the interned product handle
+    ProductHandle GetProductHandle() const;
+
+    // Get the bid ladder, best first
+    const PriceLadder<kMaxBookLevels>& GetBidLadder() const;
 
-    // Get the offer stack
-    const std::vector<Order>& GetOfferStack() const;
+    // Get the offer ladder, best first
+    const PriceLadder<kMaxBookLevels>& GetOfferLadder() const;
     
-    // Get the best bid/offer order
-    const BidOffer GetBidOffer() const;
+    // Get the best bid/offer order, kept up to date by every update
+    // A side without any level reads as a zero price and quantity
+    const BidOffer& GetBidOffer() const;
+
+    // Whether both sides hold at least one level
+    bool IsTwoSided() const;
+
+    // Get a view over the best count levels of a side, for depth-aware algos
+    LadderView GetTopLevels(PricingSide side, std::size_t count) const;
+
+    // Apply a level delta, recording it among the changes of the current update
+    void Apply(const LevelDelta& delta);
+
+    // Get the level deltas applied since the last ClearChanges()
+    const std::vector<LevelDelta>& GetChanges() const;
+
+    // Start a new update
+    void ClearChanges();
 
 private:
-    T product;
-    std::vector<Order> bidStack;
-    std::vector<Order> offerStack;
+    ProductHandle product = kInvalidProductHandle;
+    PriceLadder<kMaxBookLevels> bidLadder = PriceLadder<kMaxBookLevels>(true);
+    PriceLadder<kMaxBookLevels> offerLadder = PriceLadder<kMaxBookLevels>(false);
+    std::vector<LevelDelta> changes;
+    BidOffer bidOffer;
+
+    // Refresh the cached best order of a side after its top level changed
+    void RefreshBest(PricingSide side);
 
 };
 
 template <typename T>
 class MarketDataConnector;
 
+// Aggregate orders into price levels in place, best price first for the side
+// Returns the number of levels, which occupy the front of the range
+std::size_t AggregateOrders(Order* orders, std::size_t count, PricingSide side);
+
 /**
  * Market Data Service which distributes market data
  * Keyed on product identifier.
@@ -112,7 +164,7 @@ class MarketDataService : public Service<string,OrderBook <T> >
 {
 private:
     
-    unordered_map<string, OrderBook<T>> order_books_;
+    ProductTable<OrderBook<T>> order_books_;
     MarketDataConnector<T>* in_connector_;
     int book_depth_;
     
@@ -126,6 +178,13 @@ public:
     
     // The callback that a Connector should invoke for any new or updated data
     virtual void OnMessage(OrderBook<T>& book) override;
+
+    // Apply level deltas to the book of a product in place, then notify listeners once
+    void OnDeltas(ProductHandle product, const LevelDelta* deltas, std::size_t count);
+
+    // Bring the book of a product to a full snapshot of orders, only changing the levels that differ
+    // The stacks are aggregated in place
+    void OnSnapshot(ProductHandle product, std::vector<Order>& bid_stack, std::vector<Order>& offer_stack);
     
     // Add a listener to the Service for callbacks on add, remove, and update events
     // for data to the Service.
@@ -141,22 +200,49 @@ public:
     int GetBookDepth() const;
     
     // Get the best bid/offer order
-    virtual const BidOffer GetBestBidOffer(const std::string &productId) const;
+    virtual const BidOffer& GetBestBidOffer(const std::string &productId) const;
 
     // Aggregate the order book
     virtual const OrderBook<T>& AggregateDepth(const std::string &productId);
     
 private:
-    // AggregateDepth helper function
-    std::vector<Order> AggregateStack(const std::vector<Order>& original_stack) const;
+    // AggregateDepth helper function, aggregates a stack of one side in place
+    void AggregateStack(std::vector<Order>& stack, PricingSide side) const;
+
+    // Get the book of a product, creating an empty one if needed
+    OrderBook<T>& FetchBook(ProductHandle product);
+
+    // Append the deltas turning one side of a book into the given levels, sorted best first
+    void DiffSide(const OrderBook<T>& book, PricingSide side, const std::vector<Order>& levels);
+
+    // Notify listeners of an update to a book
+    void NotifyListeners(OrderBook<T>& book);
+
+    // Deltas reused across updates
+    std::vector<LevelDelta> deltas_;
 
 };
 
+/**
+ * Raw orders of both sides of one book, as read from a run of snapshot lines.
+ */
+struct OrderBookSnapshot
+{
+    ProductHandle product = kInvalidProductHandle;
+    std::vector<Order> bids;
+    std::vector<Order> offers;
+};
+
 template <typename T>
 class MarketDataConnector : public Connector<OrderBook<T>> {
 private:
     MarketDataService<T>* service_;
     
+    // Book being assembled from consecutive order lines
+    vector<Order> bid_stack_;
+    vector<Order> offer_stack_;
+    int order_count_;
+    
 public:
     MarketDataConnector(MarketDataService<T>* service);
     ~MarketDataConnector() = default;
@@ -168,16 +254,28 @@ public:
     
     // Subscribe data from the Connector
     virtual void Subscribe(ifstream& data) override;
+    
+    // Subscribe data from a memory-mapped file
+    virtual void Subscribe(const MappedFile& data) override;
+    
+    // Parse a single order line, publishing the book once it is deep enough
+    void ParseLine(string_view line);
+
+    // Parse a single non-empty order line, cusip is set to its product field
+    Order ParseOrder(string_view line, string_view& cusip) const;
+
+    // Parse the lines of one whole snapshot into its raw orders
+    void ParseSnapshot(string_view lines, OrderBookSnapshot& snapshot) const;
 };
 
-Order::Order(double _price, long _quantity, PricingSide _side)
+Order::Order(Ticks256 _price, long _quantity, PricingSide _side)
 {
     price = _price;
     quantity = _quantity;
     side = _side;
 }
 
-double Order::GetPrice() const
+Ticks256 Order::GetPrice() const
 {
     return this->price;
 }
@@ -209,58 +307,117 @@ const Order& BidOffer::GetOfferOrder() const
 
 template <typename T>
 OrderBook<T>::OrderBook(const T &_product, const std::vector<Order> &_bidStack, const std::vector<Order> &_offerStack) :
-  product(_product), bidStack(_bidStack), offerStack(_offerStack)
+  OrderBook(ProductRegistry<T>::Instance().Intern(_product), _bidStack, _offerStack)
 {
 }
 
 template <typename T>
-OrderBook<T>::OrderBook(const T &_product, std::vector<Order>&& _bidStack, std::vector<Order>&& _offerStack) : product(_product), bidStack(_bidStack), offerStack(_offerStack) {}
+OrderBook<T>::OrderBook(ProductHandle _product, const std::vector<Order> &_bidStack, const std::vector<Order> &_offerStack) :
+  product(_product)
+{
+    for (const auto& order : _bidStack) {
+        this->bidLadder.Add(order.GetPrice(), order.GetQuantity());
+    }
+    for (const auto& order : _offerStack) {
+        this->offerLadder.Add(order.GetPrice(), order.GetQuantity());
+    }
+    this->RefreshBest(BID);
+    this->RefreshBest(OFFER);
+}
+
+template <typename T>
+OrderBook<T>::OrderBook(ProductHandle _product) : product(_product)
+{
+    this->RefreshBest(BID);
+    this->RefreshBest(OFFER);
+}
 
 template <typename T>
 const T& OrderBook<T>::GetProduct() const
+{
+    return ProductRegistry<T>::Instance().Get(this->product);
+}
+
+template <typename T>
+ProductHandle OrderBook<T>::GetProductHandle() const
 {
     return this->product;
 }
 
 template <typename T>
-const std::vector<Order>& OrderBook<T>::GetBidStack() const
+const PriceLadder<kMaxBookLevels>& OrderBook<T>::GetBidLadder() const
 {
-    return this->bidStack;
+    return this->bidLadder;
 }
 
 template <typename T>
-const std::vector<Order>& OrderBook<T>::GetOfferStack() const
+const PriceLadder<kMaxBookLevels>& OrderBook<T>::GetOfferLadder() const
 {
-    return this->offerStack;
+    return this->offerLadder;
 }
 
 template <typename T>
-const BidOffer OrderBook<T>::GetBidOffer() const {
-    // Get highest bid order
-    const Order* highest_bid_order(&this->bidStack[0]);
-    double highest_bid_price = highest_bid_order->GetPrice();
-    for (std::size_t i = 1; i < bidStack.size(); i++) {
-        if (bidStack[i].GetPrice() > highest_bid_price) {
-            highest_bid_order = &bidStack[i];
-            highest_bid_price = highest_bid_order->GetPrice();
-        }
+const BidOffer& OrderBook<T>::GetBidOffer() const {
+    return this->bidOffer;
+}
+
+template <typename T>
+bool OrderBook<T>::IsTwoSided() const {
+    return !this->bidLadder.IsEmpty() && !this->offerLadder.IsEmpty();
+}
+
+template <typename T>
+LadderView OrderBook<T>::GetTopLevels(PricingSide side, std::size_t count) const {
+    return (side == BID) ? this->bidLadder.GetTop(count) : this->offerLadder.GetTop(count);
+}
+
+template <typename T>
+void OrderBook<T>::Apply(const LevelDelta& delta) {
+    PriceLadder<kMaxBookLevels>& ladder = (delta.side == BID) ? this->bidLadder : this->offerLadder;
+    std::size_t index = kMaxBookLevels;
+    switch (delta.action) {
+        case LEVEL_ADD:
+            index = ladder.Add(delta.price, delta.quantity);
+            break;
+        case LEVEL_MODIFY:
+            index = ladder.Set(delta.price, delta.quantity);
+            break;
+        case LEVEL_DELETE:
+            index = ladder.Remove(delta.price);
+            break;
     }
+    // Only a change at the top of a side moves the best bid/offer
+    if (index == 0) {
+        this->RefreshBest(delta.side);
+    }
+    this->changes.push_back(delta);
+}
 
-    // Get lowest offer order
-    const Order* lowest_offer_order(&this->offerStack[0]);
-    double lowest_offer_price = lowest_offer_order->GetPrice();
-    for (std::size_t i = 1; i < offerStack.size(); i++) {
-        if (offerStack[i].GetPrice() < lowest_offer_price) {
-            lowest_offer_order = &offerStack[i];
-            lowest_offer_price = lowest_offer_order->GetPrice();
-        }
+template <typename T>
+void OrderBook<T>::RefreshBest(PricingSide side) {
+    const PriceLadder<kMaxBookLevels>& ladder = (side == BID) ? this->bidLadder : this->offerLadder;
+    Order best = ladder.IsEmpty() ? Order(Ticks256(), 0, side) : Order(ladder[0].price, ladder[0].quantity, side);
+    if (side == BID) {
+        this->bidOffer = BidOffer(best, this->bidOffer.GetOfferOrder());
+    } else {
+        this->bidOffer = BidOffer(this->bidOffer.GetBidOrder(), best);
     }
+}
+
+template <typename T>
+const std::vector<LevelDelta>& OrderBook<T>::GetChanges() const {
+    return this->changes;
+}
 
-    return BidOffer(*highest_bid_order, *lowest_offer_order);
+template <typename T>
+void OrderBook<T>::ClearChanges() {
+    // Keeps the capacity, the next update reuses it
+    this->changes.clear();
 }
 
 template <typename T>
-MarketDataService<T>::MarketDataService() : order_books_(), in_connector_(new MarketDataConnector<T>(this)), book_depth_(10) {}
+MarketDataService<T>::MarketDataService() :
+  order_books_(), in_connector_(new MarketDataConnector<T>(this)), book_depth_(10) {}
 
 template <typename T>
 MarketDataService<T>::~MarketDataService() {
@@ -269,15 +426,88 @@ MarketDataService<T>::~MarketDataService() {
 
 template <typename T>
 OrderBook<T>& MarketDataService<T>::GetData(string product_id) {
-    return order_books_.at(product_id);
+    return order_books_.At(ProductRegistry<T>::Instance().Find(product_id));
 }
 
 template <typename T>
 void MarketDataService<T>::OnMessage(OrderBook<T>& book) {
-    string product_id = book.GetProduct().GetProductId();
-    this->order_books_.insert_or_assign(product_id, book);
-    
-    // Also notify listeners
+    this->order_books_.InsertOrAssign(book.GetProductHandle(), book);
+    this->NotifyListeners(book);
+}
+
+template <typename T>
+void MarketDataService<T>::OnDeltas(ProductHandle product, const LevelDelta* deltas, std::size_t count) {
+    OrderBook<T>& book = this->FetchBook(product);
+    book.ClearChanges();
+    for (std::size_t i = 0; i < count; i++) {
+        book.Apply(deltas[i]);
+    }
+    this->NotifyListeners(book);
+}
+
+template <typename T>
+void MarketDataService<T>::OnSnapshot(ProductHandle product, std::vector<Order>& bid_stack, std::vector<Order>& offer_stack) {
+    OrderBook<T>& book = this->FetchBook(product);
+    this->AggregateStack(bid_stack, BID);
+    this->AggregateStack(offer_stack, OFFER);
+
+    deltas_.clear();
+    this->DiffSide(book, BID, bid_stack);
+    this->DiffSide(book, OFFER, offer_stack);
+    this->OnDeltas(product, deltas_.data(), deltas_.size());
+}
+
+template <typename T>
+OrderBook<T>& MarketDataService<T>::FetchBook(ProductHandle product) {
+    if (!this->order_books_.Contains(product)) {
+        this->order_books_.InsertOrAssign(product, OrderBook<T>(product));
+    }
+    return this->order_books_.At(product);
+}
+
+template <typename T>
+void MarketDataService<T>::DiffSide(const OrderBook<T>& book, PricingSide side, const std::vector<Order>& levels) {
+    const PriceLadder<kMaxBookLevels>& current = (side == BID) ? book.GetBidLadder() : book.GetOfferLadder();
+    auto ranks_ahead = [side](Ticks256 price, Ticks256 other) {
+        return (side == BID) ? (price > other) : (price < other);
+    };
+
+    // Both sides are sorted best first, so one merge pass finds every difference
+    LevelDelta delta;
+    delta.side = side;
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < current.GetSize() || j < levels.size()) {
+        if (j == levels.size() || (i < current.GetSize() && ranks_ahead(current[i].price, levels[j].GetPrice()))) {
+            // Level gone from the snapshot
+            delta.action = LEVEL_DELETE;
+            delta.price = current[i].price;
+            delta.quantity = 0;
+            deltas_.push_back(delta);
+            i++;
+        } else if (i == current.GetSize() || ranks_ahead(levels[j].GetPrice(), current[i].price)) {
+            // Level new to the snapshot
+            delta.action = LEVEL_ADD;
+            delta.price = levels[j].GetPrice();
+            delta.quantity = levels[j].GetQuantity();
+            deltas_.push_back(delta);
+            j++;
+        } else {
+            // Level in both, changed only if its quantity moved
+            if (current[i].quantity != levels[j].GetQuantity()) {
+                delta.action = LEVEL_MODIFY;
+                delta.price = levels[j].GetPrice();
+                delta.quantity = levels[j].GetQuantity();
+                deltas_.push_back(delta);
+            }
+            i++;
+            j++;
+        }
+    }
+}
+
+template <typename T>
+void MarketDataService<T>::NotifyListeners(OrderBook<T>& book) {
     for (auto& l : Service<string, OrderBook<T>>::listeners_) {
         l->ProcessAdd(book);
     }
@@ -307,62 +537,53 @@ int MarketDataService<T>::GetBookDepth() const {
 
 // Get the best bid/offer order
 template <typename T>
-const BidOffer MarketDataService<T>::GetBestBidOffer(const std::string &productId) const {
-    return this->order_books_.find(productId)->second.GetBidOffer();
+const BidOffer& MarketDataService<T>::GetBestBidOffer(const std::string &productId) const {
+    return this->order_books_.At(ProductRegistry<T>::Instance().Find(productId)).GetBidOffer();
 }
 
-// AggregateDepth helper function
-template <typename T>
-std::vector<Order> MarketDataService<T>::AggregateStack(const std::vector<Order>& original_stack) const {
-    
-    unordered_map<double, long> order_map;
-    
-    for (const auto& order : original_stack) {
-        if (order_map.find(order.GetPrice()) == order_map.end()) {
-            // The price does not exist yet
-            order_map[order.GetPrice()] = order.GetQuantity();
+std::size_t AggregateOrders(Order* orders, std::size_t count, PricingSide side) {
+    if (count == 0) return 0;
+
+    // Sort best first, equal prices end up adjacent
+    if (side == BID) {
+        std::sort(orders, orders + count, [](const Order& a, const Order& b) { return a.GetPrice() > b.GetPrice(); });
+    } else {
+        std::sort(orders, orders + count, [](const Order& a, const Order& b) { return a.GetPrice() < b.GetPrice(); });
+    }
+
+    // Merge each run of equal prices into its first slot
+    std::size_t levels = 0;
+    Ticks256 price = orders[0].GetPrice();
+    long quantity = orders[0].GetQuantity();
+    for (std::size_t i = 1; i < count; i++) {
+        if (orders[i].GetPrice() == price) {
+            quantity += orders[i].GetQuantity();
         } else {
-            // The price already exists
-            order_map[order.GetPrice()] += order.GetQuantity();
+            orders[levels++] = Order(price, quantity, side);
+            price = orders[i].GetPrice();
+            quantity = orders[i].GetQuantity();
         }
     }
-    
-    std::vector<Order> aggregated_stack;
-    aggregated_stack.reserve(order_map.size());
-    for (auto [price, quantity] : order_map) {
-        Order order(price, quantity, BID);
-        aggregated_stack.push_back(order);
-    }
-    
-    return aggregated_stack;
+    orders[levels++] = Order(price, quantity, side);
+    return levels;
+}
+
+// AggregateDepth helper function
+template <typename T>
+void MarketDataService<T>::AggregateStack(std::vector<Order>& stack, PricingSide side) const {
+    // Shrinking keeps the capacity, so no allocation happens here
+    stack.resize(AggregateOrders(stack.data(), stack.size(), side));
 }
 
 // Aggregate the order book
-// Also modify that book
+// Books are kept as aggregated price levels, so this is the book itself
 template <typename T>
 const OrderBook<T>& MarketDataService<T>::AggregateDepth(const std::string &productId) {
-    const T& product = order_books_.at(productId).GetProduct();
-    
-    // Aggregate bid orders
-    const std::vector<Order>& original_bid_stack = order_books_.at(productId).GetBidStack();
-    
-    std::vector<Order> aggregated_bid_stack = this->AggregateStack(original_bid_stack);
-    
-    // Aggregate offer orders
-    const std::vector<Order>& original_offer_stack = order_books_.at(productId).GetOfferStack();
-    
-    std::vector<Order> aggregated_offer_stack = this->AggregateStack(original_offer_stack);
-    
-    OrderBook<T> aggregated_order_book(product, std::move(aggregated_bid_stack), std::move(aggregated_offer_stack));
-//    OrderBook<T> aggregated_order_book(product, aggregated_bid_stack, aggregated_offer_stack);
-    
-    this->order_books_.at(productId) = aggregated_order_book;
-    
-    return this->order_books_.at(productId);
+    return order_books_.At(ProductRegistry<T>::Instance().Find(productId));
 }
 
 template <typename T>
-MarketDataConnector<T>::MarketDataConnector(MarketDataService<T>* service) : service_(service) {}
+MarketDataConnector<T>::MarketDataConnector(MarketDataService<T>* service) : service_(service), order_count_(0) {}
 
 template <typename T>
 void MarketDataConnector<T>::Publish(OrderBook<T> &data) {
@@ -372,53 +593,83 @@ void MarketDataConnector<T>::Publish(OrderBook<T> &data) {
 
 template <typename T>
 void MarketDataConnector<T>::Subscribe(ifstream &data) {
+    string line;
+    while (getline(data, line)) {
+        this->ParseLine(line);
+    }
+}
+
+template <typename T>
+void MarketDataConnector<T>::Subscribe(const MappedFile &data) {
+    LineReader reader(data.GetView());
+    string_view line;
+    while (reader.Next(line)) {
+        this->ParseLine(line);
+    }
+}
+
+template <typename T>
+void MarketDataConnector<T>::ParseLine(string_view line) {
+    if (line.empty()) return;
+    // A snapshot enters the system with its first line
+    if (order_count_ == 0) StampIngress();
     
     int book_depth = this->service_->GetBookDepth();
     int read_lines = book_depth << 1;
     
-    vector<Order> bid_stack;
-    vector<Order> offer_stack;
+    string_view cusip;
+    Order order = this->ParseOrder(line, cusip);
     
-    string line;
-    unsigned order_count = 0;
-    while (getline(data, line)) {
-        // Separate line with delimiter ','
-        stringstream line_stream(line);
-        string line_entry;
-        vector<string> line_entries;
-        while (getline(line_stream, line_entry, ',')) {
-            line_entries.push_back(line_entry);
-        }
-        
-        // Parse data into Order
-        string product_id = line_entries[0];
-        double price = ConvertPrice(line_entries[1]);
-        long quantity = stol(line_entries[2]);
-        PricingSide side = (line_entries[3] == "BID") ? BID : OFFER;
-        Order order(price, quantity, side);
+    // Push data to stack
+    if (order.GetSide() == BID) {
+        bid_stack_.push_back(order);
+    } else {
+        offer_stack_.push_back(order);
+    }
+    
+    // Apply the snapshot to the book once it is deep enough
+    order_count_++;
+    if (order_count_ == read_lines) {
+        this->service_->OnSnapshot(FetchBondHandle(cusip), bid_stack_, offer_stack_);
         
-        // Push data to stack
-        if (side == BID) {
-            bid_stack.push_back(order);
-        } else {
-            offer_stack.push_back(order);
-        }
+        bid_stack_.clear();
+        offer_stack_.clear();
+        // Note: This operation does not shrink the capacity of the vectors.
+        //   It is intended behavior since they will be filled to the same size soon.
         
-        // Publish the entire book if the OrderBook is deep enough
-        order_count++;
-        if (order_count == (read_lines)) {
-            T product = FetchBond(product_id);
-            OrderBook<T> orderbook(product, bid_stack, offer_stack);
-            this->service_->OnMessage(orderbook);
-            
-            bid_stack.clear();
-            offer_stack.clear();
-            // Note: This operation does not shrink the capacity of the vectors.
-            //   It is intended behavior since they will be filled to the same size soon.
-            
-            order_count = 0;
-        }
+        order_count_ = 0;
+    }
+}
+
+template <typename T>
+Order MarketDataConnector<T>::ParseOrder(string_view line, string_view& cusip) const {
+    // Separate line with delimiter ','
+    string_view line_entries[4];
+    SplitLine(line, line_entries, 4);
+    
+    // Parse data into Order
+    cusip = line_entries[0];
+    Ticks256 price = ConvertPrice(line_entries[1]);
+    long quantity = ParseLong(line_entries[2]);
+    PricingSide side = (line_entries[3] == "BID") ? BID : OFFER;
+    return Order(price, quantity, side);
+}
+
+template <typename T>
+void MarketDataConnector<T>::ParseSnapshot(string_view lines, OrderBookSnapshot& snapshot) const {
+    snapshot.bids.clear();
+    snapshot.offers.clear();
+    
+    LineReader reader(lines);
+    string_view line;
+    string_view cusip;
+    while (reader.Next(line)) {
+        if (line.empty()) continue;
+        Order order = this->ParseOrder(line, cusip);
+        (order.GetSide() == BID ? snapshot.bids : snapshot.offers).push_back(order);
     }
+    // Like ParseLine, the book is the product of its last line
+    snapshot.product = FetchBondHandle(cusip);
 }
 
 #endif /* MARKET_DATA_SERVICE_HPP */
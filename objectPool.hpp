@@ -0,0 +1,316 @@
+
+#ifndef ObjectPool_HPP
+#define ObjectPool_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+template<typename V>
+class ObjectPool;
+
+/**
+ * Counted reference to an object of an ObjectPool.
+ * Copies share the object, the last reference to go hands it back to the pool,
+ * so pooled payloads can sit in value types copied between services.
+ * The pool must outlive its references.
+ * Type V is the pooled type.
+ */
+template<typename V>
+class PoolRef
+{
+
+public:
+
+    PoolRef() = default;
+    PoolRef(const PoolRef& other);
+    PoolRef(PoolRef&& other) noexcept;
+    PoolRef& operator = (const PoolRef& other);
+    PoolRef& operator = (PoolRef&& other) noexcept;
+    ~PoolRef();
+
+    // Get the object, nullptr for an empty reference
+    V* Get() const;
+
+    V& operator * () const;
+    V* operator -> () const;
+
+    // Whether the reference holds an object
+    explicit operator bool () const;
+
+    // Drop the object, handing it back to the pool if this was its last reference
+    void Reset();
+
+private:
+    friend class ObjectPool<V>;
+
+    // ctor for a reference already counted by the pool
+    PoolRef(ObjectPool<V>* pool, std::uint32_t index, V* object);
+
+    ObjectPool<V>* pool_ = nullptr;
+    std::uint32_t index_ = 0;
+    V* object_ = nullptr;
+
+};
+
+/**
+ * Slab allocator of reference-counted objects, addressed by index.
+ * Objects live in slabs of kSlabSize that are allocated once and never move or
+ * shrink. Released objects go to a lock-free free list and are reused as they are,
+ * so once the pool has grown to its working set, acquiring allocates nothing.
+ * The number of objects is bounded by max_objects, acquiring past it throws.
+ * Acquire and release are safe from concurrent threads, e.g. ingestion shards.
+ * Type V is the pooled type, it must be default constructible and assignable.
+ */
+template<typename V>
+class ObjectPool
+{
+
+public:
+
+    static const std::uint32_t kSlabSize = 256;
+    static const std::uint32_t kMaxSlabs = 4096;
+
+    // ctor for a pool holding at most max_objects objects
+    ObjectPool(std::size_t max_objects = std::size_t(kSlabSize) * kMaxSlabs);
+    ~ObjectPool();
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator = (const ObjectPool&) = delete;
+
+    // Take an object from the pool and assign it V(args...)
+    // Throws length_error once max_objects objects are in use
+    template<typename... Args>
+    PoolRef<V> Acquire(Args&&... args);
+
+    // Get the number of objects allocated, in use or free
+    std::size_t GetCapacity() const;
+
+    // Get the number of objects in use
+    std::size_t GetLiveCount() const;
+
+private:
+    friend class PoolRef<V>;
+
+    static const std::uint32_t kNoIndex = 0xFFFFFFFF;
+
+    struct Slot
+    {
+        V value;
+        std::atomic<std::uint32_t> ref_count{ 0 };
+        std::atomic<std::uint32_t> next_free{ kNoIndex };
+    };
+
+    // Get the slot of an index
+    Slot& SlotAt(std::uint32_t index) const;
+
+    // Pop a free index, kNoIndex if there is none
+    std::uint32_t PopFree();
+
+    // Push an index onto the free list
+    void PushFree(std::uint32_t index);
+
+    // Allocate a slab, returns one of its indices and frees the others
+    std::uint32_t Grow();
+
+    // Count one more reference to an object
+    void AddRef(std::uint32_t index);
+
+    // Count one reference less, freeing the object with its last one
+    void Release(std::uint32_t index);
+
+    std::size_t max_objects_;
+    std::unique_ptr<std::atomic<Slot*>[]> slabs_;
+    std::atomic<std::uint32_t> slab_count_;
+    // Top of the free list in the low half, a tag bumped on every change in the high
+    // half so a stale compare-and-swap fails (no ABA)
+    std::atomic<std::uint64_t> free_head_;
+    std::atomic<std::size_t> live_count_;
+    std::mutex grow_mutex_;
+
+};
+
+template<typename V>
+PoolRef<V>::PoolRef(ObjectPool<V>* pool, std::uint32_t index, V* object) :
+    pool_(pool), index_(index), object_(object) {}
+
+template<typename V>
+PoolRef<V>::PoolRef(const PoolRef& other) :
+    pool_(other.pool_), index_(other.index_), object_(other.object_) {
+    if (pool_ != nullptr) pool_->AddRef(index_);
+}
+
+template<typename V>
+PoolRef<V>::PoolRef(PoolRef&& other) noexcept :
+    pool_(other.pool_), index_(other.index_), object_(other.object_) {
+    other.pool_ = nullptr;
+    other.object_ = nullptr;
+}
+
+template<typename V>
+PoolRef<V>& PoolRef<V>::operator = (const PoolRef& other) {
+    if (other.pool_ != nullptr) other.pool_->AddRef(other.index_);
+    this->Reset();
+    pool_ = other.pool_;
+    index_ = other.index_;
+    object_ = other.object_;
+    return *this;
+}
+
+template<typename V>
+PoolRef<V>& PoolRef<V>::operator = (PoolRef&& other) noexcept {
+    if (this != &other) {
+        this->Reset();
+        pool_ = other.pool_;
+        index_ = other.index_;
+        object_ = other.object_;
+        other.pool_ = nullptr;
+        other.object_ = nullptr;
+    }
+    return *this;
+}
+
+template<typename V>
+PoolRef<V>::~PoolRef() {
+    this->Reset();
+}
+
+template<typename V>
+V* PoolRef<V>::Get() const {
+    return this->object_;
+}
+
+template<typename V>
+V& PoolRef<V>::operator * () const {
+    return *object_;
+}
+
+template<typename V>
+V* PoolRef<V>::operator -> () const {
+    return object_;
+}
+
+template<typename V>
+PoolRef<V>::operator bool () const {
+    return object_ != nullptr;
+}
+
+template<typename V>
+void PoolRef<V>::Reset() {
+    if (pool_ != nullptr) {
+        pool_->Release(index_);
+        pool_ = nullptr;
+        object_ = nullptr;
+    }
+}
+
+template<typename V>
+ObjectPool<V>::ObjectPool(std::size_t max_objects) :
+    max_objects_(max_objects), slabs_(new std::atomic<Slot*>[kMaxSlabs]), slab_count_(0),
+    free_head_(kNoIndex), live_count_(0) {
+    for (std::uint32_t i = 0; i < kMaxSlabs; i++) {
+        slabs_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+template<typename V>
+ObjectPool<V>::~ObjectPool() {
+    for (std::uint32_t i = 0; i < kMaxSlabs; i++) {
+        delete[] slabs_[i].load(std::memory_order_relaxed);
+    }
+}
+
+template<typename V>
+typename ObjectPool<V>::Slot& ObjectPool<V>::SlotAt(std::uint32_t index) const {
+    return slabs_[index / kSlabSize].load(std::memory_order_acquire)[index % kSlabSize];
+}
+
+template<typename V>
+std::uint32_t ObjectPool<V>::PopFree() {
+    std::uint64_t head = free_head_.load(std::memory_order_acquire);
+    while (true) {
+        std::uint32_t index = std::uint32_t(head);
+        if (index == kNoIndex) return kNoIndex;
+        std::uint32_t next = SlotAt(index).next_free.load(std::memory_order_relaxed);
+        std::uint64_t desired = (((head >> 32) + 1) << 32) | next;
+        if (free_head_.compare_exchange_weak(head, desired, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            return index;
+        }
+    }
+}
+
+template<typename V>
+void ObjectPool<V>::PushFree(std::uint32_t index) {
+    std::uint64_t head = free_head_.load(std::memory_order_relaxed);
+    std::uint64_t desired;
+    do {
+        SlotAt(index).next_free.store(std::uint32_t(head), std::memory_order_relaxed);
+        desired = (((head >> 32) + 1) << 32) | index;
+    } while (!free_head_.compare_exchange_weak(head, desired, std::memory_order_release, std::memory_order_relaxed));
+}
+
+template<typename V>
+std::uint32_t ObjectPool<V>::Grow() {
+    std::lock_guard<std::mutex> lock(grow_mutex_);
+
+    // Another thread may have grown the pool while this one waited
+    std::uint32_t index = this->PopFree();
+    if (index != kNoIndex) return index;
+
+    std::uint32_t slab = slab_count_.load(std::memory_order_relaxed);
+    std::size_t first = std::size_t(slab) * kSlabSize;
+    if (slab >= kMaxSlabs || first >= max_objects_) {
+        throw std::length_error("ObjectPool: out of objects");
+    }
+    slabs_[slab].store(new Slot[kSlabSize], std::memory_order_release);
+    slab_count_.store(slab + 1, std::memory_order_relaxed);
+
+    std::uint32_t last = std::uint32_t(std::min(first + kSlabSize, max_objects_)) - 1;
+    for (std::uint32_t i = last; i > std::uint32_t(first); i--) {
+        this->PushFree(i);
+    }
+    return std::uint32_t(first);
+}
+
+template<typename V>
+template<typename... Args>
+PoolRef<V> ObjectPool<V>::Acquire(Args&&... args) {
+    std::uint32_t index = this->PopFree();
+    if (index == kNoIndex) index = this->Grow();
+
+    Slot& slot = SlotAt(index);
+    slot.value = V(std::forward<Args>(args)...);
+    slot.ref_count.store(1, std::memory_order_relaxed);
+    live_count_.fetch_add(1, std::memory_order_relaxed);
+    return PoolRef<V>(this, index, &slot.value);
+}
+
+template<typename V>
+void ObjectPool<V>::AddRef(std::uint32_t index) {
+    SlotAt(index).ref_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename V>
+void ObjectPool<V>::Release(std::uint32_t index) {
+    if (SlotAt(index).ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        live_count_.fetch_sub(1, std::memory_order_relaxed);
+        this->PushFree(index);
+    }
+}
+
+template<typename V>
+std::size_t ObjectPool<V>::GetCapacity() const {
+    return std::min(std::size_t(slab_count_.load(std::memory_order_relaxed)) * kSlabSize, max_objects_);
+}
+
+template<typename V>
+std::size_t ObjectPool<V>::GetLiveCount() const {
+    return live_count_.load(std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,372 @@
+
+#ifndef PipelineStage_HPP
+#define PipelineStage_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include "soa.hpp"
+#include "latencyMonitor.hpp"
+
+/**
+ * Bounded lock-free ring buffer for exactly one producer thread and one consumer thread.
+ * The producer only writes tail_ and the consumer only writes head_, each on its own
+ * cache line, so neither side ever takes a lock.
+ * Type V is the element type, it must be default constructible and copy assignable.
+ */
+template<typename V>
+class SpscRingBuffer
+{
+
+public:
+
+    // ctor for a ring holding at least the given number of elements (rounded up to a power of two)
+    SpscRingBuffer(std::size_t capacity);
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator = (const SpscRingBuffer&) = delete;
+
+    // Push an element, returns false if the ring is full (producer side)
+    bool TryPush(const V& value);
+
+    // Pop the oldest element, returns false if the ring is empty (consumer side)
+    bool TryPop(V& value);
+
+    // Whether the ring is currently empty
+    bool IsEmpty() const;
+
+    // Get the capacity of the ring
+    std::size_t GetCapacity() const;
+
+private:
+    static const std::size_t kCacheLineSize = 64;
+
+    std::vector<V> slots_;
+    std::size_t mask_;
+    alignas(kCacheLineSize) std::atomic<std::size_t> head_;
+    alignas(kCacheLineSize) std::atomic<std::size_t> tail_;
+
+};
+
+/**
+ * Input of a PipelineStage: something the stage thread can drain.
+ */
+class StagePort
+{
+
+public:
+    virtual ~StagePort() = default;
+
+    // Process up to max_count pending events, returns the number processed
+    virtual std::size_t Drain(std::size_t max_count) = 0;
+
+};
+
+/**
+ * A thread running one group of services.
+ * Upstream services hand events to the stage through StageListeners. The stage
+ * thread drains its ports round-robin and runs the downstream listeners, so a slow
+ * group (e.g. persistence) never blocks the thread that produced the event.
+ */
+class PipelineStage
+{
+
+public:
+
+    // ctor for a stage, pinned to the given cpu unless it is negative
+    PipelineStage(std::string _name, int _cpu = -1);
+    ~PipelineStage();
+
+    PipelineStage(const PipelineStage&) = delete;
+    PipelineStage& operator = (const PipelineStage&) = delete;
+
+    // Add an input to the stage, must be called before Start()
+    void AddPort(StagePort* port);
+
+    // Start the stage thread
+    void Start();
+
+    // Drain every port until empty, then stop the stage thread
+    void Stop();
+
+    // Get the name of the stage
+    const std::string& GetName() const;
+
+private:
+    // Body of the stage thread
+    void Run();
+
+    // Drain every port once, returns the number of events processed
+    std::size_t DrainPorts();
+
+    std::string name_;
+    int cpu_;
+    std::vector<StagePort*> ports_;
+    std::atomic<bool> is_running_;
+    std::thread thread_;
+
+};
+
+/**
+ * Listener decoupling a service from its downstream listener through a SPSC ring.
+ * ProcessAdd/Remove/Update copy the event into the ring on the producer thread and
+ * return, the stage thread replays them on the downstream listener in arrival order.
+ * Ordering: events crossing one StageListener are delivered in the order they were
+ *   produced, so updates for a given product keep their order along every edge.
+ *   No ordering is defined between events crossing different StageListeners.
+ * Backpressure: a full ring blocks the producer (spin, then yield) until the stage
+ *   catches up, so memory stays bounded and no event is ever dropped.
+ * Producers: each producer thread gets its own ring, chosen by the slot it set with
+ *   SetProducerSlot, so several threads (e.g. ingestion shards) can feed one listener.
+ *   Ordering then holds per producer.
+ * The ingress time of each event travels with it, so latency keeps adding up across the stage.
+ * Without a stage the listener forwards synchronously on the calling thread.
+ * Type V is the data type.
+ */
+template<typename V>
+class StageListener final : public ServiceListener<V>, public StagePort
+{
+
+public:
+
+    // ctor forwarding to the downstream listener, through the stage if one is given,
+    // with one ring per producer thread
+    StageListener(ServiceListener<V>* downstream, PipelineStage* stage = nullptr, std::size_t capacity = 4096, std::size_t producer_count = 1);
+    ~StageListener() = default;
+
+    // Listener callback to process an add event to the Service
+    virtual void ProcessAdd(V &data) override;
+
+    // Listener callback to process a remove event to the Service
+    virtual void ProcessRemove(V &data) override;
+
+    // Listener callback to process an update event to the Service
+    virtual void ProcessUpdate(V &data) override;
+
+    // Replay pending events on the downstream listener (stage thread)
+    virtual std::size_t Drain(std::size_t max_count) override;
+
+private:
+    enum EventType { ADD, REMOVE, UPDATE };
+
+    struct Event
+    {
+        EventType type = ADD;
+        std::int64_t ingress = 0;
+        V data;
+    };
+
+    // Hand an event to the stage, waiting while the ring is full
+    void Enqueue(EventType type, V& data);
+
+    // Deliver an event to the downstream listener
+    void Dispatch(EventType type, V& data);
+
+    ServiceListener<V>* downstream_;
+    PipelineStage* stage_;
+    std::vector<std::unique_ptr<SpscRingBuffer<Event>>> rings_;
+    std::size_t next_ring_;
+    Event pending_;
+
+};
+
+// Ring slot of the calling thread in every StageListener it produces into
+thread_local std::size_t tls_producer_slot = 0;
+
+// Set the ring slot of the calling thread, each concurrent producer needs its own
+void SetProducerSlot(std::size_t slot) {
+    tls_producer_slot = slot;
+}
+
+// Pin the calling thread to a cpu, ignored if the cpu is negative
+void PinCurrentThread(int cpu) {
+    if (cpu < 0) return;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu % CPU_SETSIZE, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+}
+
+// Back off while waiting on a ring: spin briefly, then give the core away
+void WaitBackoff(unsigned& idle_rounds) {
+    if (++idle_rounds < 64) return;
+    if (idle_rounds < 1024) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+template<typename V>
+SpscRingBuffer<V>::SpscRingBuffer(std::size_t capacity) : head_(0), tail_(0) {
+    std::size_t size = 1;
+    while (size < capacity) size <<= 1;
+    slots_.resize(size);
+    mask_ = size - 1;
+}
+
+template<typename V>
+bool SpscRingBuffer<V>::TryPush(const V& value) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) {
+        return false;
+    }
+    slots_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename V>
+bool SpscRingBuffer<V>::TryPop(V& value) {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    value = slots_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename V>
+bool SpscRingBuffer<V>::IsEmpty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+}
+
+template<typename V>
+std::size_t SpscRingBuffer<V>::GetCapacity() const {
+    return slots_.size();
+}
+
+PipelineStage::PipelineStage(std::string _name, int _cpu) : name_(_name), cpu_(_cpu), is_running_(false) {}
+
+PipelineStage::~PipelineStage() {
+    this->Stop();
+}
+
+void PipelineStage::AddPort(StagePort* port) {
+    this->ports_.push_back(port);
+}
+
+void PipelineStage::Start() {
+    if (is_running_.exchange(true)) return;
+    thread_ = std::thread(&PipelineStage::Run, this);
+}
+
+void PipelineStage::Stop() {
+    if (!is_running_.exchange(false)) return;
+    thread_.join();
+}
+
+const std::string& PipelineStage::GetName() const {
+    return this->name_;
+}
+
+std::size_t PipelineStage::DrainPorts() {
+    const std::size_t kBatch = 256;
+    std::size_t processed = 0;
+    for (auto& port : ports_) {
+        processed += port->Drain(kBatch);
+    }
+    return processed;
+}
+
+void PipelineStage::Run() {
+    PinCurrentThread(cpu_);
+
+    unsigned idle_rounds = 0;
+    while (is_running_.load(std::memory_order_acquire)) {
+        if (this->DrainPorts() > 0) {
+            idle_rounds = 0;
+        } else {
+            WaitBackoff(idle_rounds);
+        }
+    }
+
+    // Producers are done once Stop() is called, deliver whatever is left
+    while (this->DrainPorts() > 0) {}
+}
+
+template<typename V>
+StageListener<V>::StageListener(ServiceListener<V>* downstream, PipelineStage* stage, std::size_t capacity, std::size_t producer_count) :
+    downstream_(downstream), stage_(stage), next_ring_(0) {
+    if (stage_ != nullptr) {
+        for (std::size_t i = 0; i < std::max<std::size_t>(1, producer_count); i++) {
+            rings_.emplace_back(new SpscRingBuffer<Event>(capacity));
+        }
+        stage_->AddPort(this);
+    }
+}
+
+template<typename V>
+void StageListener<V>::ProcessAdd(V &data) {
+    this->Enqueue(ADD, data);
+}
+
+template<typename V>
+void StageListener<V>::ProcessRemove(V &data) {
+    this->Enqueue(REMOVE, data);
+}
+
+template<typename V>
+void StageListener<V>::ProcessUpdate(V &data) {
+    this->Enqueue(UPDATE, data);
+}
+
+template<typename V>
+void StageListener<V>::Enqueue(EventType type, V& data) {
+    if (stage_ == nullptr) {
+        this->Dispatch(type, data);
+        return;
+    }
+
+    Event event;
+    event.type = type;
+    event.ingress = GetIngressTime();
+    event.data = data;
+    SpscRingBuffer<Event>& ring = *rings_[tls_producer_slot % rings_.size()];
+    unsigned idle_rounds = 0;
+    while (!ring.TryPush(event)) {
+        WaitBackoff(idle_rounds);
+    }
+}
+
+template<typename V>
+void StageListener<V>::Dispatch(EventType type, V& data) {
+    switch (type) {
+        case ADD:
+            downstream_->ProcessAdd(data);
+            break;
+        case REMOVE:
+            downstream_->ProcessRemove(data);
+            break;
+        case UPDATE:
+            downstream_->ProcessUpdate(data);
+            break;
+    }
+}
+
+template<typename V>
+std::size_t StageListener<V>::Drain(std::size_t max_count) {
+    // Start from a different ring each time so a busy producer cannot starve the others
+    std::size_t processed = 0;
+    next_ring_ = (next_ring_ + 1) % rings_.size();
+    for (std::size_t i = 0; i < rings_.size(); i++) {
+        SpscRingBuffer<Event>& ring = *rings_[(next_ring_ + i) % rings_.size()];
+        while (processed < max_count && ring.TryPop(pending_)) {
+            SetIngressTime(pending_.ingress);
+            this->Dispatch(pending_.type, pending_.data);
+            processed++;
+        }
+    }
+    return processed;
+}
+
+#endif
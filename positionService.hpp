@@ -2,17 +2,25 @@
 #ifndef PositionService_HPP
 #define PositionService_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
 #include <string>
-#include <map>
+#include <string_view>
 #include <unordered_map>
 #include "soa.hpp"
+#include "bookRegistry.hpp"
 #include "tradeBookingService.hpp"
 #include <vector>
 
 using namespace std;
 
 /**
- * Position class in a particular book.
+ * Position class across the books of a product.
+ * Quantities sit in one slot per inline book, next to their running aggregate,
+ * so booking a trade is one add to each and a whole Position fits a cache line.
+ * Books past the inline ones keep their quantities in a list allocated on first use.
  * Type T is the product type.
  */
 template<typename T>
@@ -24,24 +32,45 @@ public:
     Position() = default;
     // ctor for a position
     Position(const T &_product);
+    Position(ProductHandle _product);
+
+    // Copies take their own list of overflow books
+    Position(const Position& other);
+    Position& operator = (const Position& other);
+    Position(Position&&) = default;
+    Position& operator = (Position&&) = default;
 
     // Get the product
     const T& GetProduct() const;
 
-    // Get the position quantity
-    long GetPosition(string &book);
+    // Get the interned product handle
+    ProductHandle GetProductHandle() const;
+
+    // Get the position quantity, 0 for a book without trades
+    long GetPosition(string_view book) const;
+    long GetPosition(BookHandle book) const;
 
     // Get the aggregate position
-    long GetAggregatePosition();
+    long GetAggregatePosition() const;
+
+    // Call visit(book name, quantity) for every book traded, in book name order
+    template<typename Visitor>
+    void ForEachBook(Visitor visit) const;
     
     // Add position to designated book
-    void AddPosition(string& book, long position, Side side);
+    void AddPosition(string_view book, long position, Side side);
+    void AddPosition(BookHandle book, long position, Side side);
 
     vector<string> ToString() const;
     
 private:
-    T product;
-    map<string, long> positions;
+    typedef vector<pair<BookHandle, long>> OverflowBooks;
+
+    ProductHandle product = kInvalidProductHandle;
+    std::uint32_t booked = 0;  // Bit per inline book traded
+    long aggregate = 0;
+    long positions[BookRegistry::kInlineBooks] = {};
+    unique_ptr<OverflowBooks> overflow;  // Books past the inline ones, in order traded
 
 };
 
@@ -59,7 +88,7 @@ template<typename T>
 class PositionService : public Service<string,Position <T> >
 {
 private:
-    unordered_map<string, Position<T>> positions_;
+    ProductTable<Position<T>> positions_;
     TradeBookingToPositionListener<T>* in_listener_;
 
 public:
@@ -86,7 +115,7 @@ public:
 };
 
 template<typename T>
-class TradeBookingToPositionListener : public ServiceListener<Trade<T>> {
+class TradeBookingToPositionListener final : public ServiceListener<Trade<T>> {
 private:
     PositionService<T>* service_;
     
@@ -106,43 +135,133 @@ public:
 
 template<typename T>
 Position<T>::Position(const T &_product) :
+  product(ProductRegistry<T>::Instance().Intern(_product)) {}
+
+template<typename T>
+Position<T>::Position(ProductHandle _product) :
   product(_product) {}
 
+template<typename T>
+Position<T>::Position(const Position& other) :
+  product(other.product), booked(other.booked), aggregate(other.aggregate),
+  overflow(other.overflow ? new OverflowBooks(*other.overflow) : nullptr)
+{
+    std::copy(other.positions, other.positions + BookRegistry::kInlineBooks, positions);
+}
+
+template<typename T>
+Position<T>& Position<T>::operator = (const Position& other)
+{
+    if (this != &other) {
+        product = other.product;
+        booked = other.booked;
+        aggregate = other.aggregate;
+        std::copy(other.positions, other.positions + BookRegistry::kInlineBooks, positions);
+        overflow.reset(other.overflow ? new OverflowBooks(*other.overflow) : nullptr);
+    }
+    return *this;
+}
+
 template<typename T>
 const T& Position<T>::GetProduct() const
+{
+    return ProductRegistry<T>::Instance().Get(product);
+}
+
+template<typename T>
+ProductHandle Position<T>::GetProductHandle() const
 {
     return product;
 }
 
 template<typename T>
-long Position<T>::GetPosition(string &book)
+long Position<T>::GetPosition(string_view book) const
 {
-    return positions[book];
+    BookHandle handle = BookRegistry::Instance().Find(book);
+    return (handle == kInvalidBookHandle) ? 0 : this->GetPosition(handle);
 }
 
 template<typename T>
-void Position<T>::AddPosition(string& book, long position, Side side) {
-    // Insert 0 if the book does not exist
-    positions.try_emplace(book, 0);
-    
-    switch (side) {
-        case BUY:
-            positions[book] += position;
-            break;
-        case SELL:
-            positions[book] -= position;
-            break;
+long Position<T>::GetPosition(BookHandle book) const
+{
+    if (book < BookRegistry::kInlineBooks) {
+        return positions[book];
+    }
+    if (overflow) {
+        for (const auto& [overflow_book, quantity] : *overflow) {
+            if (overflow_book == book) return quantity;
+        }
     }
+    return 0;
 }
 
 template<typename T>
-long Position<T>::GetAggregatePosition() {
-    long res = 0;
-    for (const auto& [book, pos] : positions) {
-        res += pos;
+template<typename Visitor>
+void Position<T>::ForEachBook(Visitor visit) const
+{
+    // Handles follow registration order, sort the few traded ones by name
+    const BookRegistry& registry = BookRegistry::Instance();
+    BookHandle order[BookRegistry::kInlineBooks];
+    std::size_t count = 0;
+    for (BookHandle book = 0; book < BookRegistry::kInlineBooks; book++) {
+        if (!(booked & (1u << book))) continue;
+        std::size_t i = count++;
+        for (; i > 0 && registry.Get(book) < registry.Get(order[i - 1]); i--) {
+            order[i] = order[i - 1];
+        }
+        order[i] = book;
+    }
+    if (!overflow) {
+        for (std::size_t i = 0; i < count; i++) {
+            visit(registry.Get(order[i]), positions[order[i]]);
+        }
+        return;
+    }
+
+    // Merge in the overflow books, rare enough to sort them all together
+    OverflowBooks books(*overflow);
+    for (std::size_t i = 0; i < count; i++) {
+        books.emplace_back(order[i], positions[order[i]]);
+    }
+    std::sort(books.begin(), books.end(), [&registry](const auto& a, const auto& b) {
+        return registry.Get(a.first) < registry.Get(b.first);
+    });
+    for (const auto& [book, quantity] : books) {
+        visit(registry.Get(book), quantity);
     }
-    
-    return res;
+}
+
+template<typename T>
+void Position<T>::AddPosition(string_view book, long position, Side side) {
+    this->AddPosition(BookRegistry::Instance().Intern(book), position, side);
+}
+
+template<typename T>
+void Position<T>::AddPosition(BookHandle book, long position, Side side) {
+    if (book == kInvalidBookHandle) {
+        throw out_of_range("Position: invalid book handle");
+    }
+    long quantity = (side == BUY) ? position : -position;
+    aggregate += quantity;
+    if (book < BookRegistry::kInlineBooks) {
+        positions[book] += quantity;
+        booked |= 1u << book;
+        return;
+    }
+
+    if (!overflow) overflow.reset(new OverflowBooks());
+    for (auto& [overflow_book, overflow_quantity] : *overflow) {
+        if (overflow_book == book) {
+            overflow_quantity += quantity;
+            return;
+        }
+    }
+    overflow->emplace_back(book, quantity);
+}
+
+template<typename T>
+long Position<T>::GetAggregatePosition() const {
+    return aggregate;
 }
 
 template <typename T>
@@ -157,13 +276,12 @@ PositionService<T>::~PositionService() {
 
 template <typename T>
 Position<T>& PositionService<T>::GetData(string product_id) {
-    return positions_[product_id];
+    return positions_[ProductRegistry<T>::Instance().Find(product_id)];
 }
 
 template <typename T>
 void PositionService<T>::OnMessage(Position<T>& data) {
-    string product_id = data.GetProduct().GetProductId();
-    this->positions_[product_id] = data;
+    this->positions_[data.GetProductHandle()] = data;
 }
 
 template <typename T>
@@ -185,19 +303,17 @@ template <typename T>
 void PositionService<T>::AddTrade(const Trade<T> &trade) {
     
     // Get data from the trade
-    T product = trade.GetProduct();
-    string product_id = product.GetProductId();
-    double price = trade.GetPrice();
-    string book = trade.GetBook();
+    ProductHandle product = trade.GetProductHandle();
+    BookHandle book = trade.GetBookHandle();
     long quantity = trade.GetQuantity();
     Side side = trade.GetSide();
     
-    positions_.try_emplace(product_id, product);
-    positions_[product_id].AddPosition(book, quantity, side);
+    Position<T>& position = positions_.TryEmplace(product, product);
+    position.AddPosition(book, quantity, side);
     
     // Notify listeners
     for (auto& l : Service<string, Position<T>>::listeners_) {
-        l->ProcessAdd(positions_[product_id]);
+        l->ProcessAdd(position);
     }
 }
 
@@ -219,19 +335,12 @@ void TradeBookingToPositionListener<T>::ProcessUpdate(Trade<T>& data) {}
 template<typename T>
 vector<string> Position<T>::ToString() const
 {
-    string _product = product.GetProductId();
-    vector<string> _positions;
-    for (auto& p : positions)
-    {
-        string _book = p.first;
-        string _position = to_string(p.second);
-        _positions.push_back(_book);
-        _positions.push_back(_position);
-    }
-
     vector<string> _strings;
-    _strings.push_back(_product);
-    _strings.insert(_strings.end(), _positions.begin(), _positions.end());
+    _strings.push_back(this->GetProduct().GetProductId());
+    this->ForEachBook([&_strings](const string& book, long position) {
+        _strings.push_back(book);
+        _strings.push_back(to_string(position));
+    });
     return _strings;
 }
 
@@ -0,0 +1,220 @@
+
+#ifndef PriceLadder_HPP
+#define PriceLadder_HPP
+
+#include <array>
+#include <cstddef>
+#include "priceTicks.hpp"
+
+/**
+ * Aggregate quantity resting at one price.
+ */
+struct PriceLevel
+{
+    Ticks256 price;
+    long quantity = 0;
+};
+
+/**
+ * Read-only view over the best levels of a ladder, valid until the ladder changes.
+ */
+struct LadderView
+{
+    const PriceLevel* levels = nullptr;
+    std::size_t size = 0;
+
+    const PriceLevel& operator [] (std::size_t index) const { return levels[index]; }
+    const PriceLevel* begin() const { return levels; }
+    const PriceLevel* end() const { return levels + size; }
+};
+
+/**
+ * One side of a book as price levels sorted best first in a fixed-capacity array.
+ * Bids rank descending and offers ascending. Updates binary search the level and
+ * shift the tail in place, so the ladder never allocates.
+ * Once full, a level worse than every resting one is dropped and a better one
+ * evicts the worst.
+ * Capacity is the maximum number of levels.
+ */
+template<std::size_t Capacity>
+class PriceLadder
+{
+
+public:
+
+    // ctor for a ladder, bids are descending and offers ascending
+    PriceLadder(bool _is_descending = true);
+
+    // Get the number of levels
+    std::size_t GetSize() const;
+
+    // Whether the ladder holds no level
+    bool IsEmpty() const;
+
+    // Get the level at a depth, 0 being the best
+    const PriceLevel& operator [] (std::size_t index) const;
+
+    // Get the levels, best first
+    const PriceLevel* GetLevels() const;
+
+    // Get a view over the best count levels, or every level if there are fewer
+    LadderView GetTop(std::size_t count) const;
+
+    // Get the depth of the level at a price, GetSize() if there is none
+    std::size_t Find(Ticks256 price) const;
+
+    // Add quantity at a price, returns the depth of the level or Capacity if it was dropped
+    std::size_t Add(Ticks256 price, long quantity);
+
+    // Set the quantity at a price, a quantity of 0 or less removes the level
+    // Returns the depth of the level (its former depth if removed) or Capacity if there is none
+    std::size_t Set(Ticks256 price, long quantity);
+
+    // Remove the level at a price, returns its former depth or Capacity if there was none
+    std::size_t Remove(Ticks256 price);
+
+    // Remove every level
+    void Clear();
+
+private:
+    // Whether a price ranks ahead of another on this side
+    bool IsBetter(Ticks256 price, Ticks256 other) const;
+
+    // Depth of the first level not ranking ahead of a price
+    std::size_t LowerBound(Ticks256 price) const;
+
+    // Open a level at a depth, evicting the worst one if the ladder is full
+    std::size_t Insert(std::size_t index, Ticks256 price, long quantity);
+
+    std::array<PriceLevel, Capacity> levels_;
+    std::size_t size_;
+    bool is_descending_;
+
+};
+
+template<std::size_t Capacity>
+PriceLadder<Capacity>::PriceLadder(bool _is_descending) : levels_(), size_(0), is_descending_(_is_descending) {}
+
+template<std::size_t Capacity>
+std::size_t PriceLadder<Capacity>::GetSize() const
+{
+    return this->size_;
+}
+
+template<std::size_t Capacity>
+bool PriceLadder<Capacity>::IsEmpty() const
+{
+    return this->size_ == 0;
+}
+
+template<std::size_t Capacity>
+const PriceLevel& PriceLadder<Capacity>::operator [] (std::size_t index) const
+{
+    return levels_[index];
+}
+
+template<std::size_t Capacity>
+const PriceLevel* PriceLadder<Capacity>::GetLevels() const
+{
+    return levels_.data();
+}
+
+template<std::size_t Capacity>
+LadderView PriceLadder<Capacity>::GetTop(std::size_t count) const
+{
+    LadderView view;
+    view.levels = levels_.data();
+    view.size = (count < size_) ? count : size_;
+    return view;
+}
+
+template<std::size_t Capacity>
+bool PriceLadder<Capacity>::IsBetter(Ticks256 price, Ticks256 other) const
+{
+    return is_descending_ ? (price > other) : (price < other);
+}
+
+template<std::size_t Capacity>
+std::size_t PriceLadder<Capacity>::LowerBound(Ticks256 price) const
+{
+    std::size_t low = 0;
+    std::size_t high = size_;
+    while (low < high) {
+        std::size_t middle = (low + high) >> 1;
+        if (this->IsBetter(levels_[middle].price, price)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+template<std::size_t Capacity>
+std::size_t PriceLadder<Capacity>::Find(Ticks256 price) const
+{
+    std::size_t index = this->LowerBound(price);
+    return (index < size_ && levels_[index].price == price) ? index : size_;
+}
+
+template<std::size_t Capacity>
+std::size_t PriceLadder<Capacity>::Insert(std::size_t index, Ticks256 price, long quantity)
+{
+    if (index >= Capacity) return Capacity;
+    if (size_ < Capacity) size_++;
+
+    // Shift the worse levels down, the worst one falls off a full ladder
+    for (std::size_t i = size_ - 1; i > index; i--) {
+        levels_[i] = levels_[i - 1];
+    }
+    levels_[index].price = price;
+    levels_[index].quantity = quantity;
+    return index;
+}
+
+template<std::size_t Capacity>
+std::size_t PriceLadder<Capacity>::Add(Ticks256 price, long quantity)
+{
+    std::size_t index = this->LowerBound(price);
+    if (index < size_ && levels_[index].price == price) {
+        levels_[index].quantity += quantity;
+        return index;
+    }
+    return this->Insert(index, price, quantity);
+}
+
+template<std::size_t Capacity>
+std::size_t PriceLadder<Capacity>::Set(Ticks256 price, long quantity)
+{
+    if (quantity <= 0) {
+        return this->Remove(price);
+    }
+
+    std::size_t index = this->LowerBound(price);
+    if (index < size_ && levels_[index].price == price) {
+        levels_[index].quantity = quantity;
+        return index;
+    }
+    return this->Insert(index, price, quantity);
+}
+
+template<std::size_t Capacity>
+std::size_t PriceLadder<Capacity>::Remove(Ticks256 price)
+{
+    std::size_t index = this->Find(price);
+    if (index == size_) return Capacity;
+
+    for (std::size_t i = index + 1; i < size_; i++) {
+        levels_[i - 1] = levels_[i];
+    }
+    size_--;
+    return index;
+}
+
+template<std::size_t Capacity>
+void PriceLadder<Capacity>::Clear()
+{
+    this->size_ = 0;
+}
+
+#endif
@@ -17,13 +17,13 @@ public:
 
     PriceStreamOrder() = default;
     // ctor for an order
-    PriceStreamOrder(double _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side);
+    PriceStreamOrder(Ticks256 _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side);
 
     // The side on this order
     PricingSide GetSide() const;
 
     // Get the price on this order
-    double GetPrice() const;
+    Ticks256 GetPrice() const;
 
     // Get the visible quantity on this order
     long GetVisibleQuantity() const;
@@ -34,7 +34,7 @@ public:
     vector<string> ToString() const;
 
 private:
-    double price;
+    Ticks256 price;
     long visibleQuantity;
     long hiddenQuantity;
     PricingSide side;
@@ -54,10 +54,14 @@ public:
     PriceStream() = default;
     // ctor
     PriceStream(const T &_product, const PriceStreamOrder &_bidOrder, const PriceStreamOrder &_offerOrder);
+    PriceStream(ProductHandle _product, const PriceStreamOrder &_bidOrder, const PriceStreamOrder &_offerOrder);
 
     // Get the product
     const T& GetProduct() const;
 
+    // Get the interned product handle
+    ProductHandle GetProductHandle() const;
+
     // Get the bid order
     const PriceStreamOrder& GetBidOrder() const;
 
@@ -67,13 +71,13 @@ public:
     vector<string> ToString() const;
 
 private:
-    T product;
+    ProductHandle product = kInvalidProductHandle;
     PriceStreamOrder bidOrder;
     PriceStreamOrder offerOrder;
 
 };
 
-PriceStreamOrder::PriceStreamOrder(double _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side)
+PriceStreamOrder::PriceStreamOrder(Ticks256 _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side)
 {
     price = _price;
     visibleQuantity = _visibleQuantity;
@@ -86,7 +90,7 @@ PricingSide PriceStreamOrder::GetSide() const
     return this->side;
 }
 
-double PriceStreamOrder::GetPrice() const
+Ticks256 PriceStreamOrder::GetPrice() const
 {
     return this->price;
 }
@@ -103,10 +107,20 @@ long PriceStreamOrder::GetHiddenQuantity() const
 
 template<typename T>
 PriceStream<T>::PriceStream(const T &_product, const PriceStreamOrder &_bidOrder, const PriceStreamOrder &_offerOrder) :
+  product(ProductRegistry<T>::Instance().Intern(_product)), bidOrder(_bidOrder), offerOrder(_offerOrder) {}
+
+template<typename T>
+PriceStream<T>::PriceStream(ProductHandle _product, const PriceStreamOrder &_bidOrder, const PriceStreamOrder &_offerOrder) :
   product(_product), bidOrder(_bidOrder), offerOrder(_offerOrder) {}
 
 template<typename T>
 const T& PriceStream<T>::GetProduct() const
+{
+    return ProductRegistry<T>::Instance().Get(this->product);
+}
+
+template<typename T>
+ProductHandle PriceStream<T>::GetProductHandle() const
 {
     return this->product;
 }
@@ -150,7 +164,7 @@ vector<string> PriceStreamOrder::ToString() const
 template<typename T>
 vector<string> PriceStream<T>::ToString() const
 {
-    string _product = this->product.GetProductId();
+    string _product = this->GetProduct().GetProductId();
     vector<string> _bidOrder = this->bidOrder.ToString();
     vector<string> _offerOrder = this->offerOrder.ToString();
 
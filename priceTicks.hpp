@@ -0,0 +1,113 @@
+
+#ifndef PriceTicks_HPP
+#define PriceTicks_HPP
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * A bond price held as an integer number of 1/256 ticks.
+ * Every quoted treasury price (32nds plus a 256ths digit) is exact in this
+ * representation, so comparisons and aggregation are plain integer ops.
+ */
+class Ticks256
+{
+
+public:
+
+    // Number of ticks in one point of price
+    static const long kTicksPerPoint = 256;
+
+    Ticks256() = default;
+    // ctor from a raw tick count
+    explicit Ticks256(long _ticks);
+
+    // Get the raw tick count
+    long GetTicks() const;
+
+    // Get the price in points, for analytics only
+    double ToDouble() const;
+
+    Ticks256 operator + (Ticks256 other) const;
+    Ticks256 operator - (Ticks256 other) const;
+    Ticks256& operator += (Ticks256 other);
+    Ticks256& operator -= (Ticks256 other);
+
+    // Divide the tick count, rounding toward negative infinity
+    Ticks256 operator / (long divisor) const;
+
+    bool operator == (Ticks256 other) const;
+    bool operator != (Ticks256 other) const;
+    bool operator < (Ticks256 other) const;
+    bool operator <= (Ticks256 other) const;
+    bool operator > (Ticks256 other) const;
+    bool operator >= (Ticks256 other) const;
+
+private:
+    long ticks = 0;
+
+};
+
+Ticks256::Ticks256(long _ticks) : ticks(_ticks) {}
+
+long Ticks256::GetTicks() const
+{
+    return this->ticks;
+}
+
+double Ticks256::ToDouble() const
+{
+    return double(ticks) / kTicksPerPoint;
+}
+
+Ticks256 Ticks256::operator + (Ticks256 other) const
+{
+    return Ticks256(ticks + other.ticks);
+}
+
+Ticks256 Ticks256::operator - (Ticks256 other) const
+{
+    return Ticks256(ticks - other.ticks);
+}
+
+Ticks256& Ticks256::operator += (Ticks256 other)
+{
+    ticks += other.ticks;
+    return *this;
+}
+
+Ticks256& Ticks256::operator -= (Ticks256 other)
+{
+    ticks -= other.ticks;
+    return *this;
+}
+
+Ticks256 Ticks256::operator / (long divisor) const
+{
+    long quotient = ticks / divisor;
+    if ((ticks % divisor != 0) && ((ticks < 0) != (divisor < 0))) {
+        quotient--;
+    }
+    return Ticks256(quotient);
+}
+
+bool Ticks256::operator == (Ticks256 other) const { return ticks == other.ticks; }
+bool Ticks256::operator != (Ticks256 other) const { return ticks != other.ticks; }
+bool Ticks256::operator < (Ticks256 other) const { return ticks < other.ticks; }
+bool Ticks256::operator <= (Ticks256 other) const { return ticks <= other.ticks; }
+bool Ticks256::operator > (Ticks256 other) const { return ticks > other.ticks; }
+bool Ticks256::operator >= (Ticks256 other) const { return ticks >= other.ticks; }
+
+namespace std
+{
+    template<>
+    struct hash<Ticks256>
+    {
+        std::size_t operator () (Ticks256 price) const
+        {
+            return std::hash<long>()(price.GetTicks());
+        }
+    };
+}
+
+#endif
@@ -3,10 +3,12 @@
 #define PricingService_HPP
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include "soa.hpp"
 #include "utilities.hpp"
+#include "latencyMonitor.hpp"
 
 /**
  * A price object consisting of mid and bid/offer spread.
@@ -20,26 +22,27 @@ public:
 
     Price() = default;
     // ctor for a price
-    Price(const T &_product, double _mid, double _bidOfferSpread);
-    Price(const Price<T>& price);
-    
-    Price<T>& operator = (const Price<T>& price);
+    Price(const T &_product, Ticks256 _mid, Ticks256 _bidOfferSpread);
+    Price(ProductHandle _product, Ticks256 _mid, Ticks256 _bidOfferSpread);
 
     // Get the product
     const T& GetProduct() const;
 
+    // Get the interned product handle
+    ProductHandle GetProductHandle() const;
+
     // Get the mid price
-    double GetMid() const;
+    Ticks256 GetMid() const;
 
     // Get the bid/offer spread around the mid
-    double GetBidOfferSpread() const;
+    Ticks256 GetBidOfferSpread() const;
     
     vector<string> ToString() const;
 
 private:
-    T product;
-    double mid;
-    double bidOfferSpread;
+    ProductHandle product = kInvalidProductHandle;
+    Ticks256 mid;
+    Ticks256 bidOfferSpread;
 
 };
 
@@ -54,7 +57,7 @@ class PricingConnector;
 template <typename T>
 class PricingService : public Service<string,Price <T> > {
 private:
-    unordered_map<string, Price<T>> prices_;
+    ProductTable<Price<T>> prices_;
     PricingConnector<T>* in_connector_;
     
 public:
@@ -66,6 +69,9 @@ public:
     
     // The callback that a Connector should invoke for any new or updated data
     virtual void OnMessage(Price<T>& data) override;
+
+    // The callback for data the caller hands over, moved into the service
+    virtual void OnMessage(Price<T>&& data) override;
     
     // Add a listener to the Service for callbacks on add, remove, and update events
     // for data to the Service.
@@ -91,44 +97,53 @@ public:
 
     // Subscribe data from the Connector
     virtual void Subscribe(ifstream& data) override;
+
+    // Subscribe data from a memory-mapped file
+    virtual void Subscribe(const MappedFile& data) override;
+
+    // Parse a single line and push it to the service
+    void ParseLine(string_view line);
+
+    // Parse a single non-empty line into a price
+    Price<T> Parse(string_view line) const;
 };
 
 template <typename T>
-Price<T>::Price(const T& _product, double _mid, double _bidOfferSpread) :
-    product(_product)
+Price<T>::Price(const T& _product, Ticks256 _mid, Ticks256 _bidOfferSpread) :
+    product(ProductRegistry<T>::Instance().Intern(_product))
 {
     mid = _mid;
     bidOfferSpread = _bidOfferSpread;
 }
 
 template <typename T>
-Price<T>::Price(const Price<T>& price) :
-    product(price.product), mid(price.mid), bidOfferSpread(price.bidOfferSpread) {}
+Price<T>::Price(ProductHandle _product, Ticks256 _mid, Ticks256 _bidOfferSpread) :
+    product(_product)
+{
+    mid = _mid;
+    bidOfferSpread = _bidOfferSpread;
+}
 
 template <typename T>
-Price<T>& Price<T>::operator = (const Price<T>& price) {
-    if (&price != this) {
-        product = price.product;
-        mid = price.mid;
-        bidOfferSpread = price.bidOfferSpread;
-    }
-    return *this;
+const T& Price<T>::GetProduct() const
+{
+    return ProductRegistry<T>::Instance().Get(this->product);
 }
 
 template <typename T>
-const T& Price<T>::GetProduct() const
+ProductHandle Price<T>::GetProductHandle() const
 {
     return this->product;
 }
 
 template <typename T>
-double Price<T>::GetMid() const
+Ticks256 Price<T>::GetMid() const
 {
     return this->mid;
 }
 
 template <typename T>
-double Price<T>::GetBidOfferSpread() const
+Ticks256 Price<T>::GetBidOfferSpread() const
 {
     return this->bidOfferSpread;
 }
@@ -145,12 +160,12 @@ PricingService<T>::~PricingService() {
 
 template <typename T>
 Price<T>& PricingService<T>::GetData(string product_id) {
-    return this->prices_[product_id];
+    return this->prices_[ProductRegistry<T>::Instance().Find(product_id)];
 }
 
 template <typename T>
 void PricingService<T>::OnMessage(Price<T>& data) {
-    string product_id = data.GetProduct().GetProductId();
+    this->prices_.InsertOrAssign(data.GetProductHandle(), data);
 
     // Also notify listeners
     for (auto& l : Service<string, Price<T>>::listeners_) {
@@ -158,6 +173,17 @@ void PricingService<T>::OnMessage(Price<T>& data) {
     }
 }
 
+template <typename T>
+void PricingService<T>::OnMessage(Price<T>&& data) {
+    ProductHandle product = data.GetProductHandle();
+    Price<T>& price = this->prices_.InsertOrAssign(product, std::move(data));
+
+    // Also notify listeners
+    for (auto& l : Service<string, Price<T>>::listeners_) {
+        l->ProcessAdd(price);
+    }
+}
+
 template <typename T>
 void PricingService<T>::AddListener(ServiceListener<Price<T>>* listener) {
     this->Service<string, Price<T>>::AddListener(listener);
@@ -185,32 +211,52 @@ void PricingConnector<T>::Subscribe(ifstream& data)
     string line;
     while (getline(data, line))
     {
-        // Separate line with delimiter ','
-        stringstream line_stream(line);
-        string line_entry;
-        vector<string> line_entries;
-        while (getline(line_stream, line_entry, ',')) {
-            line_entries.push_back(line_entry);
-        }
-
-        // Parse data into Price
-        string product_id = line_entries[0];
-        double bid_price = ConvertPrice(line_entries[1]);
-        double offer_price = ConvertPrice(line_entries[2]);
-        double mid_price = (bid_price + offer_price) / 2.;
-        double spread = offer_price - bid_price;
-        T product = FetchBond(product_id);
-        Price<T> price(product, mid_price, spread);
-
-        // Push price to connecting service
-        service_->OnMessage(price);
+        this->ParseLine(line);
+    }
+}
+
+template<typename T>
+void PricingConnector<T>::Subscribe(const MappedFile& data)
+{
+    LineReader reader(data.GetView());
+    string_view line;
+    while (reader.Next(line))
+    {
+        this->ParseLine(line);
     }
 }
 
+template<typename T>
+void PricingConnector<T>::ParseLine(string_view line)
+{
+    if (line.empty()) return;
+    StampIngress();
+
+    // Push price to connecting service
+    service_->OnMessage(this->Parse(line));
+}
+
+template<typename T>
+Price<T> PricingConnector<T>::Parse(string_view line) const
+{
+    // Separate line with delimiter ','
+    string_view line_entries[3];
+    SplitLine(line, line_entries, 3);
+
+    // Parse data into Price
+    ProductHandle product = FetchBondHandle(line_entries[0]);
+    Ticks256 bid_price = ConvertPrice(line_entries[1]);
+    Ticks256 offer_price = ConvertPrice(line_entries[2]);
+    // The mid is floored to a whole tick, bid = mid - spread / 2 recovers the quote exactly
+    Ticks256 mid_price = (bid_price + offer_price) / 2;
+    Ticks256 spread = offer_price - bid_price;
+    return Price<T>(product, mid_price, spread);
+}
+
 template<typename T>
 vector<string> Price<T>::ToString() const
 {
-    string _product = product.GetProductId();
+    string _product = this->GetProduct().GetProductId();
     string _mid = ConvertPrice(mid);
     string _bidOfferSpread = ConvertPrice(bidOfferSpread);
 
@@ -0,0 +1,91 @@
+
+#ifndef ProductRegistry_HPP
+#define ProductRegistry_HPP
+
+#include <deque>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+
+// Compact handle to an interned product, dense from 0 in registration order
+typedef unsigned ProductHandle;
+
+const ProductHandle kInvalidProductHandle = std::numeric_limits<ProductHandle>::max();
+
+/**
+ * Registry interning each product exactly once for the whole process.
+ * Messages carry a ProductHandle instead of a product copy, and services key
+ * their state on the handle instead of hashing the product identifier.
+ * Type T is the product type, it must expose GetProductId().
+ */
+template<typename T>
+class ProductRegistry
+{
+
+public:
+
+    // Get the registry shared by every service
+    static ProductRegistry<T>& Instance();
+
+    // Intern a product, returns the existing handle if it is already registered
+    ProductHandle Intern(const T& product);
+
+    // Find the handle of a product identifier, kInvalidProductHandle if unknown
+    ProductHandle Find(std::string_view product_id) const;
+
+    // Get the product behind a handle
+    const T& Get(ProductHandle handle) const;
+
+    // Get the number of registered products
+    std::size_t GetSize() const;
+
+private:
+    ProductRegistry() = default;
+
+    // deque keeps references stable, so the index can view the stored identifiers
+    std::deque<T> products_;
+    std::unordered_map<std::string_view, ProductHandle> handles_;
+
+};
+
+template<typename T>
+ProductRegistry<T>& ProductRegistry<T>::Instance()
+{
+    static ProductRegistry<T> registry;
+    return registry;
+}
+
+template<typename T>
+ProductHandle ProductRegistry<T>::Intern(const T& product)
+{
+    auto found = handles_.find(product.GetProductId());
+    if (found != handles_.end()) {
+        return found->second;
+    }
+
+    ProductHandle handle = ProductHandle(products_.size());
+    products_.push_back(product);
+    handles_.emplace(products_.back().GetProductId(), handle);
+    return handle;
+}
+
+template<typename T>
+ProductHandle ProductRegistry<T>::Find(std::string_view product_id) const
+{
+    auto found = handles_.find(product_id);
+    return (found == handles_.end()) ? kInvalidProductHandle : found->second;
+}
+
+template<typename T>
+const T& ProductRegistry<T>::Get(ProductHandle handle) const
+{
+    return products_[handle];
+}
+
+template<typename T>
+std::size_t ProductRegistry<T>::GetSize() const
+{
+    return products_.size();
+}
+
+#endif
@@ -0,0 +1,197 @@
+
+#ifndef RecordWriter_HPP
+#define RecordWriter_HPP
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+// When written records are forced to stable storage
+enum FsyncPolicy { FSYNC_NEVER, FSYNC_ON_FLUSH, FSYNC_ON_CLOSE };
+
+/**
+ * Durability settings of a RecordWriter.
+ * Pending records are written out once flush_records of them have accumulated
+ * or flush_interval has elapsed since the last flush, whichever comes first.
+ */
+struct WriterPolicy
+{
+    std::size_t flush_records = 1024;
+    std::chrono::microseconds flush_interval = std::chrono::microseconds(1000);
+    FsyncPolicy fsync = FSYNC_NEVER;
+};
+
+/**
+ * Append-only writer keeping its file open for the whole run.
+ * Producers append formatted records to an in-memory batch. A background
+ * flusher swaps the batch out and writes it with a single syscall (group commit),
+ * so producers never wait on the disk.
+ * A file that cannot be opened silently discards its records, the same way an
+ * ofstream that failed to open does.
+ */
+class RecordWriter
+{
+
+public:
+
+    // ctor opening the file at the given path for appending
+    RecordWriter(const std::string& path, WriterPolicy policy = WriterPolicy());
+    ~RecordWriter();
+
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator = (const RecordWriter&) = delete;
+
+    // Append one record, it must carry its own line terminator
+    void Append(std::string_view record);
+
+    // Write every pending record now, fsyncing if the policy asks for it
+    void Flush();
+
+    // Whether the file has been opened
+    bool IsOpen() const;
+
+    // Get the durability settings
+    const WriterPolicy& GetPolicy() const;
+
+private:
+    // Body of the flusher thread
+    void Run();
+
+    // Write out the pending batch, must be called with mutex_ held
+    void FlushLocked(std::unique_lock<std::mutex>& lock, bool sync);
+
+    // Write a whole buffer to the file, retrying short writes
+    void WriteAll(const std::string& buffer);
+
+    int fd_;
+    WriterPolicy policy_;
+    std::string pending_;
+    std::string writing_;
+    std::size_t pending_records_;
+    bool is_stopping_;
+    bool is_flushing_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    std::thread flusher_;
+
+};
+
+RecordWriter::RecordWriter(const std::string& path, WriterPolicy policy) :
+    fd_(-1), policy_(policy), pending_records_(0), is_stopping_(false), is_flushing_(false)
+{
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd_ >= 0) {
+        flusher_ = std::thread(&RecordWriter::Run, this);
+    }
+}
+
+RecordWriter::~RecordWriter()
+{
+    if (fd_ < 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_stopping_ = true;
+    }
+    wake_.notify_one();
+    flusher_.join();
+
+    // The flusher wrote everything out on its way down
+    if (policy_.fsync != FSYNC_NEVER) {
+        ::fsync(fd_);
+    }
+    ::close(fd_);
+}
+
+void RecordWriter::Append(std::string_view record)
+{
+    if (fd_ < 0) return;
+
+    bool is_full = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.append(record.data(), record.size());
+        is_full = (++pending_records_ >= policy_.flush_records);
+    }
+    if (is_full) {
+        wake_.notify_one();
+    }
+}
+
+void RecordWriter::Flush()
+{
+    if (fd_ < 0) return;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    this->FlushLocked(lock, policy_.fsync == FSYNC_ON_FLUSH);
+}
+
+bool RecordWriter::IsOpen() const
+{
+    return fd_ >= 0;
+}
+
+const WriterPolicy& RecordWriter::GetPolicy() const
+{
+    return this->policy_;
+}
+
+void RecordWriter::Run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!is_stopping_) {
+        wake_.wait_for(lock, policy_.flush_interval, [this]() {
+            return is_stopping_ || pending_records_ >= policy_.flush_records;
+        });
+        this->FlushLocked(lock, policy_.fsync == FSYNC_ON_FLUSH);
+    }
+    this->FlushLocked(lock, false);
+}
+
+void RecordWriter::FlushLocked(std::unique_lock<std::mutex>& lock, bool sync)
+{
+    // Only one batch is in flight at a time, so records reach the file in append order
+    flushed_.wait(lock, [this]() { return !is_flushing_; });
+    if (pending_.empty()) return;
+
+    writing_.swap(pending_);
+    pending_records_ = 0;
+    is_flushing_ = true;
+
+    // Producers keep appending to the fresh batch while this one is written
+    lock.unlock();
+    this->WriteAll(writing_);
+    if (sync) {
+        ::fsync(fd_);
+    }
+    writing_.clear();
+    lock.lock();
+
+    is_flushing_ = false;
+    flushed_.notify_all();
+}
+
+void RecordWriter::WriteAll(const std::string& buffer)
+{
+    const char* data = buffer.data();
+    std::size_t remaining = buffer.size();
+    while (remaining > 0) {
+        ssize_t written = ::write(fd_, data, remaining);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += written;
+        remaining -= static_cast<std::size_t>(written);
+    }
+}
+
+#endif
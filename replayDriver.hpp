@@ -0,0 +1,216 @@
+
+#ifndef ReplayDriver_HPP
+#define ReplayDriver_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "utilities.hpp"
+#include "mappedFile.hpp"
+#include "latencyMonitor.hpp"
+
+/**
+ * Capture format: the lines of an input file, each prefixed with the time it was
+ * received as integer nanoseconds since the epoch and a comma, e.g.
+ *   1704205800000125000,BONDNO1,99-000,99-003
+ * Lines of one capture are in time order.
+ */
+
+/**
+ * Driver replaying timestamped captures of several feeds through their connectors.
+ * Feeds are merged by time with a k-way heap, ties going to the feed added first,
+ * so a replay always dispatches the same records in the same order.
+ * Speed 1 replays at the recorded pacing, N at N times that, 0 as fast as possible.
+ * Paced replays record how late each record was dispatched against its schedule.
+ */
+class ReplayDriver
+{
+
+public:
+
+    // ctor for a replay at the given speed, 0 meaning as fast as possible
+    ReplayDriver(double _speed = 0.);
+
+    // Add a feed: its capture and the function dispatching one record (timestamp stripped)
+    void AddFeed(std::string name, std::string_view capture, std::function<void(std::string_view)> dispatch);
+
+    // Replay every feed to the end, throws invalid_argument on a malformed capture
+    void Run();
+
+    // Get the replay speed
+    double GetSpeed() const;
+
+    // Get the number of records dispatched by the last Run()
+    std::size_t GetMessageCount() const;
+
+    // Get the wall time taken by the last Run()
+    std::chrono::nanoseconds GetElapsed() const;
+
+    // Get the records dispatched per second of wall time
+    double GetThroughput() const;
+
+    // Get the lag of dispatches behind their schedule, empty at full speed
+    const LatencyHistogram& GetLag() const;
+
+    // Write throughput and lag per feed
+    void Report(std::ostream& out) const;
+
+private:
+    struct Feed
+    {
+        std::string name;
+        LineReader reader;
+        std::function<void(std::string_view)> dispatch;
+        std::size_t message_count;
+    };
+
+    struct PendingRecord
+    {
+        std::int64_t timestamp;
+        std::size_t feed;
+        std::string_view record;
+
+        // Later records rank lower, so the heap top is the earliest one
+        bool operator < (const PendingRecord& other) const
+        {
+            if (timestamp != other.timestamp) return timestamp > other.timestamp;
+            return feed > other.feed;
+        }
+    };
+
+    // Read the next record of a feed onto the heap, returns false at its end
+    bool PushNext(std::size_t feed, std::priority_queue<PendingRecord>& heap);
+
+    // Wait until a scheduled time, sleeping while it is far away
+    static void WaitUntil(std::int64_t target);
+
+    double speed_;
+    std::vector<Feed> feeds_;
+    std::size_t message_count_;
+    std::chrono::nanoseconds elapsed_;
+    LatencyHistogram lag_;
+
+};
+
+ReplayDriver::ReplayDriver(double _speed) :
+    speed_(_speed), message_count_(0), elapsed_(0) {}
+
+void ReplayDriver::AddFeed(std::string name, std::string_view capture, std::function<void(std::string_view)> dispatch)
+{
+    feeds_.push_back(Feed{ std::move(name), LineReader(capture), std::move(dispatch), 0 });
+}
+
+bool ReplayDriver::PushNext(std::size_t feed, std::priority_queue<PendingRecord>& heap)
+{
+    std::string_view line;
+    do {
+        if (!feeds_[feed].reader.Next(line)) return false;
+    } while (line.empty());
+
+    std::size_t comma = line.find(',');
+    if (comma == std::string_view::npos) {
+        throw std::invalid_argument("ReplayDriver: record without timestamp in " + feeds_[feed].name);
+    }
+    heap.push({ std::int64_t(ParseLong(line.substr(0, comma))), feed, line.substr(comma + 1) });
+    return true;
+}
+
+void ReplayDriver::WaitUntil(std::int64_t target)
+{
+    const std::int64_t kSpinNanoseconds = 100000;
+    std::int64_t remaining = target - NowNanoseconds();
+    if (remaining > 2 * kSpinNanoseconds) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(remaining - kSpinNanoseconds));
+    }
+    while (NowNanoseconds() < target) {}
+}
+
+void ReplayDriver::Run()
+{
+    std::priority_queue<PendingRecord> heap;
+    for (std::size_t feed = 0; feed < feeds_.size(); feed++) {
+        feeds_[feed].message_count = 0;
+        this->PushNext(feed, heap);
+    }
+    message_count_ = 0;
+    lag_.Reset();
+    if (heap.empty()) return;
+
+    std::int64_t first_timestamp = heap.top().timestamp;
+    std::int64_t start = NowNanoseconds();
+    while (!heap.empty()) {
+        PendingRecord next = heap.top();
+        heap.pop();
+
+        if (speed_ > 0.) {
+            std::int64_t target = start + std::int64_t(double(next.timestamp - first_timestamp) / speed_);
+            this->WaitUntil(target);
+            lag_.Record(NowNanoseconds() - target);
+        }
+        feeds_[next.feed].dispatch(next.record);
+        feeds_[next.feed].message_count++;
+        message_count_++;
+
+        this->PushNext(next.feed, heap);
+    }
+    elapsed_ = std::chrono::nanoseconds(NowNanoseconds() - start);
+}
+
+double ReplayDriver::GetSpeed() const
+{
+    return this->speed_;
+}
+
+std::size_t ReplayDriver::GetMessageCount() const
+{
+    return this->message_count_;
+}
+
+std::chrono::nanoseconds ReplayDriver::GetElapsed() const
+{
+    return this->elapsed_;
+}
+
+double ReplayDriver::GetThroughput() const
+{
+    double seconds = std::chrono::duration<double>(elapsed_).count();
+    return seconds > 0. ? double(message_count_) / seconds : 0.;
+}
+
+const LatencyHistogram& ReplayDriver::GetLag() const
+{
+    return this->lag_;
+}
+
+void ReplayDriver::Report(std::ostream& out) const
+{
+    if (speed_ > 0.) {
+        out << "Replay at " << speed_ << "x: ";
+    } else {
+        out << "Replay at max speed: ";
+    }
+    for (const auto& feed : feeds_) {
+        out << feed.name << " " << feed.message_count << ", ";
+    }
+    out << message_count_ << " records in " << std::fixed << std::setprecision(3)
+        << std::chrono::duration<double>(elapsed_).count() << "s, "
+        << std::setprecision(0) << this->GetThroughput() << " records/s" << std::endl;
+    if (lag_.GetCount() > 0) {
+        out << std::setprecision(2) << "Lag behind schedule (us): p50 " << double(lag_.GetPercentile(0.5)) / 1000.
+            << " p99 " << double(lag_.GetPercentile(0.99)) / 1000.
+            << " p99.9 " << double(lag_.GetPercentile(0.999)) / 1000.
+            << " max " << double(lag_.GetMax()) / 1000. << std::endl;
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+#endif
@@ -4,6 +4,11 @@
 
 #include "soa.hpp"
 #include "positionService.hpp"
+#include "pricingService.hpp"
+#include "bondAnalytics.hpp"
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
 #include <vector>
 #include <unordered_map>
 #include "utilities.hpp"
@@ -22,10 +27,14 @@ public:
     PV01() = default;
     // ctor for a PV01 value
     PV01(const T &_product, double _pv01, long _quantity);
+    PV01(ProductHandle _product, double _pv01, long _quantity);
 
     // Get the product on this PV01 value
     const T& GetProduct() const;
 
+    // Get the interned product handle
+    ProductHandle GetProductHandle() const;
+
     // Get the PV01 value
     double GetPV01() const;
 
@@ -37,7 +46,7 @@ public:
     std::vector<std::string> ToString() const;
 
 private:
-    T product;
+    ProductHandle product = kInvalidProductHandle;
     double pv01;
     long quantity;
 
@@ -46,6 +55,7 @@ private:
 /**
  * A bucket sector to bucket a group of securities.
  * We can then aggregate bucketed risk to this bucket.
+ * Sectors are interned in their own ProductRegistry under their name.
  * Type T is the product type.
  */
 template <typename T>
@@ -64,29 +74,78 @@ public:
     // Get the name of the bucket
     const std::string& GetName() const;
 
+    // Get the name of the bucket, its identifier in the registry
+    const std::string& GetProductId() const;
+
 private:
     vector<T> products;
     string name;
 
 };
 
+// Front end (2Y, 3Y), belly (5Y, 7Y, 10Y) and long end (20Y, 30Y) of the on-the-run bonds
+std::vector<BucketedSector<Bond>> MakeTreasurySectors();
+
 template <typename T>
 class PositionToRiskListener;
 
+template <typename T>
+class PricingToRiskListener;
+
 /**
  * Risk Service to vend out risk for a particular security and across a risk bucketed sector.
  * Keyed on product identifier.
+ * PV01s come from the bond analytics at the last mid of each product, par before any
+ * price. A new price re-risks the position already booked, so the sector totals and
+ * GetData follow the market at tick rate, while listeners still hear of position changes
+ * only. A product is risked under its own lock, prices and positions may come from
+ * different threads. The universe is the products registered when the service is built,
+ * any other product throws out_of_range.
+ * Bucketed risk is kept incrementally: each sector registered once holds the total
+ * risk (PV01 times quantity) of its products, and a new position moves the totals of
+ * its product's sectors by the change in the product's risk. Totals are atomics in
+ * their own cache lines, so other threads read them without locking.
  * Type T is the product type.
  */
 template <typename T>
 class RiskService : public Service<string,PV01 <T> >
 {
 private:
-    unordered_map<std::string, PV01<T>> pv01s_;
+    static const std::size_t kMaxSectorsPerProduct = 4;
+
+    // Risk last booked for a product, what it was booked at and the sectors it counts towards
+    struct ProductRisk
+    {
+        std::mutex mutex;
+        Ticks256 price = Ticks256(100 * Ticks256::kTicksPerPoint);
+        long quantity = 0;
+        bool is_booked = false;
+        double risk = 0.;
+        std::size_t sector_count = 0;
+        ProductHandle sectors[kMaxSectorsPerProduct];
+    };
+
+    // Running total of a sector
+    struct SectorRisk
+    {
+        std::atomic<double> risk{ 0. };
+    };
+
+    // Add to a total without a lock
+    static void AddRisk(std::atomic<double>& total, double delta);
+
+    // Book the risk of a product at its price and quantity, with its lock held
+    PV01<T> BookRisk(ProductHandle product, ProductRisk& product_risk);
+
+    BondAnalytics<T> analytics_;
+    ProductTable<PV01<T>> pv01s_;
+    ProductTable<ProductRisk> product_risks_;
+    ProductTable<SectorRisk> sector_risks_;  // Keyed on sector handle
     PositionToRiskListener<T>* in_listener_;
+    PricingToRiskListener<T>* price_listener_;
     
 public:
-    RiskService();
+    RiskService(boost::gregorian::date settlement = kSettlementDate);
     ~RiskService();
     
     // Get data on our service given a key (orderbook)
@@ -104,16 +163,28 @@ public:
     
     PositionToRiskListener<T>* GetInListener();
 
+    PricingToRiskListener<T>* GetPriceListener();
+
     // Add a position that the service will risk
     void AddPosition(Position<T> &position);
 
-    // Get the bucketed risk for the bucket sector
-    const PV01<BucketedSector<T> >& GetBucketedRisk(const BucketedSector<T> &sector) const;
+    // Move the price a product is risked at
+    void AddPrice(const Price<T> &price);
+
+    // Register a sector to aggregate risk over, once and before positions flow
+    // Returns its handle, throws length_error if a product is in too many sectors
+    // and out_of_range if one is outside the universe
+    ProductHandle AddBucketedSector(const BucketedSector<T> &sector);
+
+    // Get the bucketed risk for the bucket sector: its total risk, for a quantity of 1
+    // Safe from any thread, throws out_of_range for a sector never registered
+    PV01<BucketedSector<T>> GetBucketedRisk(const BucketedSector<T> &sector) const;
+    PV01<BucketedSector<T>> GetBucketedRisk(ProductHandle sector) const;
 
 };
 
 template <typename T>
-class PositionToRiskListener : public ServiceListener<Position<T>> {
+class PositionToRiskListener final : public ServiceListener<Position<T>> {
 private:
     RiskService<T>* service_;
 
@@ -133,12 +204,42 @@ public:
 
 };
 
+template <typename T>
+class PricingToRiskListener final : public ServiceListener<Price<T>> {
+private:
+    RiskService<T>* service_;
+
+public:
+
+    PricingToRiskListener(RiskService<T>* _service);
+    ~PricingToRiskListener() = default;
+
+    // Listener callback to process an add event to the Service
+    virtual void ProcessAdd(Price<T> &data) override;
+
+    // Listener callback to process a remove event to the Service
+    virtual void ProcessRemove(Price<T> &data) override;
+
+    // Listener callback to process an update event to the Service
+    virtual void ProcessUpdate(Price<T> &data) override;
+
+};
+
 template <typename T>
 PV01<T>::PV01(const T &_product, double _pv01, long _quantity) :
+  product(ProductRegistry<T>::Instance().Intern(_product)), pv01(_pv01), quantity(_quantity) {}
+
+template <typename T>
+PV01<T>::PV01(ProductHandle _product, double _pv01, long _quantity) :
   product(_product), pv01(_pv01), quantity(_quantity) {}
 
 template<typename T>
 const T& PV01<T>::GetProduct() const {
+    return ProductRegistry<T>::Instance().Get(this->product);
+}
+
+template<typename T>
+ProductHandle PV01<T>::GetProductHandle() const {
     return this->product;
 }
 
@@ -174,24 +275,45 @@ const string& BucketedSector<T>::GetName() const
 }
 
 template <typename T>
-RiskService<T>::RiskService() {
+const string& BucketedSector<T>::GetProductId() const
+{
+    return this->name;
+}
+
+std::vector<BucketedSector<Bond>> MakeTreasurySectors() {
+    return {
+        BucketedSector<Bond>({ FetchBond(2), FetchBond(3) }, "FrontEnd"),
+        BucketedSector<Bond>({ FetchBond(5), FetchBond(7), FetchBond(10) }, "Belly"),
+        BucketedSector<Bond>({ FetchBond(20), FetchBond(30) }, "LongEnd")
+    };
+}
+
+template <typename T>
+RiskService<T>::RiskService(boost::gregorian::date settlement) : analytics_(settlement) {
+    // Open a slot for every product up front, prices and positions then only look them up,
+    // marking a slot set while another thread reads it would race
+    RegisterBondsOnce();
+    for (ProductHandle product = 0; product < ProductRegistry<T>::Instance().GetSize(); product++) {
+        this->product_risks_[product];
+    }
     this->in_listener_ = new PositionToRiskListener<T>(this);
+    this->price_listener_ = new PricingToRiskListener<T>(this);
 }
 
 template <typename T>
 RiskService<T>::~RiskService() {
     delete this->in_listener_;
+    delete this->price_listener_;
 }
 
 template <typename T>
 PV01<T>& RiskService<T>::GetData(std::string product_id) {
-    return this->pv01s_[product_id];
+    return this->pv01s_[ProductRegistry<T>::Instance().Find(product_id)];
 }
 
 template <typename T>
 void RiskService<T>::OnMessage(PV01<T>& data) {
-    std::string product_id = data.GetProduct().GetProductId();
-    this->pv01s_[product_id] = data;
+    this->pv01s_[data.GetProductHandle()] = data;
 }
 
 template <typename T>
@@ -209,19 +331,25 @@ PositionToRiskListener<T>* RiskService<T>::GetInListener() {
     return this->in_listener_;
 }
 
+template <typename T>
+PricingToRiskListener<T>* RiskService<T>::GetPriceListener() {
+    return this->price_listener_;
+}
+
 // Add a position that the service will risk
 template <typename T>
 void RiskService<T>::AddPosition(Position<T>& position) {
     
     // Parse info from position
-    T product = position.GetProduct();
-    std::string product_id = product.GetProductId();
-    long quantity = position.GetAggregatePosition();
-    
-    // Convert to PV01 obj
-    double pv01_value = GetPV01Value(product_id);
-    PV01<T> pv01(product, pv01_value, quantity);
-    this->pv01s_.insert_or_assign(product_id, pv01);
+    ProductHandle product = position.GetProductHandle();
+    ProductRisk& product_risk = this->product_risks_.At(product);
+    PV01<T> pv01;
+    {
+        std::lock_guard<std::mutex> lock(product_risk.mutex);
+        product_risk.quantity = position.GetAggregatePosition();
+        product_risk.is_booked = true;
+        pv01 = this->BookRisk(product, product_risk);
+    }
 
     // Notify listeners
     for (auto& l : Service<std::string, PV01<T>>::listeners_)
@@ -230,23 +358,76 @@ void RiskService<T>::AddPosition(Position<T>& position) {
     }
 }
 
-// Get the bucketed risk for the bucket sector
 template <typename T>
-const PV01<BucketedSector<T>>& RiskService<T>::GetBucketedRisk(const BucketedSector<T>& sector) const {
-    
-    BucketedSector<T> product = sector;
-    
-    double pv01 = 0.;
-    long quantity = 1;  // Dummy
+void RiskService<T>::AddPrice(const Price<T>& price) {
+    ProductHandle product = price.GetProductHandle();
+    ProductRisk& product_risk = this->product_risks_.At(product);
+    std::lock_guard<std::mutex> lock(product_risk.mutex);
+    product_risk.price = price.GetMid();
+    if (product_risk.is_booked) {
+        this->BookRisk(product, product_risk);
+    } else {
+        // Solve ahead of the first trade, the position books from the cache
+        this->analytics_.GetRisk(product, product_risk.price);
+    }
+}
 
-    std::vector<T>& products = sector.GetProducts();
-    for (auto& product : products)
-    {
-        std::string product_id = product.GetProductId();
-        pv01 += pv01s_[product_id].GetPV01() * pv01s_[product_id].GetQuantity();
+template <typename T>
+PV01<T> RiskService<T>::BookRisk(ProductHandle product, ProductRisk& product_risk) {
+    double pv01_value = this->analytics_.GetRisk(product, product_risk.price).pv01;
+    PV01<T> pv01(product, pv01_value, product_risk.quantity);
+    this->pv01s_.InsertOrAssign(product, pv01);
+
+    // Move the sectors of the product by the change in its risk
+    double risk = pv01_value * double(product_risk.quantity);
+    double delta = risk - product_risk.risk;
+    product_risk.risk = risk;
+    for (std::size_t i = 0; i < product_risk.sector_count; i++) {
+        AddRisk(this->sector_risks_.At(product_risk.sectors[i]).risk, delta);
     }
+    return pv01;
+}
 
-    return PV01<BucketedSector<T>>(product, pv01, quantity);
+template <typename T>
+void RiskService<T>::AddRisk(std::atomic<double>& total, double delta) {
+    double current = total.load(std::memory_order_relaxed);
+    while (!total.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {}
+}
+
+template <typename T>
+ProductHandle RiskService<T>::AddBucketedSector(const BucketedSector<T>& sector) {
+    ProductHandle handle = ProductRegistry<BucketedSector<T>>::Instance().Intern(sector);
+    if (this->sector_risks_.Contains(handle)) return handle;
+
+    // Check every product has room for the sector before linking any, so a full one leaves nothing behind
+    vector<ProductRisk*> product_risks;
+    for (const T& product : sector.GetProducts()) {
+        ProductRisk& product_risk = this->product_risks_.At(ProductRegistry<T>::Instance().Intern(product));
+        if (product_risk.sector_count == kMaxSectorsPerProduct) {
+            throw std::length_error("RiskService: " + product.GetProductId() + " is in too many sectors");
+        }
+        product_risks.push_back(&product_risk);
+    }
+
+    // Start from the risk already booked on the products of the sector
+    double risk = 0.;
+    for (ProductRisk* product_risk : product_risks) {
+        product_risk->sectors[product_risk->sector_count++] = handle;
+        risk += product_risk->risk;
+    }
+    this->sector_risks_[handle].risk.store(risk, std::memory_order_relaxed);
+    return handle;
+}
+
+template <typename T>
+PV01<BucketedSector<T>> RiskService<T>::GetBucketedRisk(const BucketedSector<T>& sector) const {
+    return this->GetBucketedRisk(ProductRegistry<BucketedSector<T>>::Instance().Find(sector.GetName()));
+}
+
+template <typename T>
+PV01<BucketedSector<T>> RiskService<T>::GetBucketedRisk(ProductHandle sector) const {
+    double risk = this->sector_risks_.At(sector).risk.load(std::memory_order_relaxed);
+    return PV01<BucketedSector<T>>(sector, risk, 1);
 }
 
 template<typename T>
@@ -264,10 +445,25 @@ void PositionToRiskListener<T>::ProcessRemove(Position<T>& data) {}
 template<typename T>
 void PositionToRiskListener<T>::ProcessUpdate(Position<T>& data) {}
 
+template<typename T>
+PricingToRiskListener<T>::PricingToRiskListener(RiskService<T>* service) : service_(service) {}
+
+template<typename T>
+void PricingToRiskListener<T>::ProcessAdd(Price<T>& data)
+{
+    this->service_->AddPrice(data);
+}
+
+template<typename T>
+void PricingToRiskListener<T>::ProcessRemove(Price<T>& data) {}
+
+template<typename T>
+void PricingToRiskListener<T>::ProcessUpdate(Price<T>& data) {}
+
 template<typename T>
 std::vector<string> PV01<T>::ToString() const
 {
-    std::string _product = product.GetProductId();
+    std::string _product = this->GetProduct().GetProductId();
     std::string _pv01 = to_string(pv01);
     std::string _quantity = to_string(quantity);
 
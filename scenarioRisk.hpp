@@ -0,0 +1,494 @@
+
+#ifndef ScenarioRisk_HPP
+#define ScenarioRisk_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "soa.hpp"
+#include "positionService.hpp"
+
+/**
+ * Shift of the yield curve in basis points, yields up being positive.
+ * Parallel moves every key rate alike. Twist moves the long end up and the short
+ * end down, pivoting in the middle. Butterfly moves both ends up and the belly down.
+ * Twist and butterfly are the shifts at the ends of the key-rate range.
+ */
+struct CurveScenario
+{
+    double parallel;
+    double twist;
+    double butterfly;
+};
+
+// Every combination of steps shifts in [-max_bp, max_bp] for each of the three factors
+std::vector<CurveScenario> MakeShockGrid(double max_bp, std::size_t steps);
+
+/**
+ * Fixed pool of worker threads running batches of tasks fork-join style.
+ * Every worker takes part in every batch, claiming tasks until none is left, and the
+ * batch ends once all of them are through. The calling thread works on the batch
+ * too, so a pool without workers runs it inline.
+ */
+class WorkerPool
+{
+
+public:
+
+    // ctor for a pool with the given number of worker threads
+    WorkerPool(std::size_t worker_count);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator = (const WorkerPool&) = delete;
+
+    // Run task(i) for every i in [0, task_count), returns once every task is done
+    // One batch at a time: Run() must not be called concurrently
+    void Run(std::size_t task_count, std::function<void(std::size_t)> task);
+
+    // Get the number of worker threads
+    std::size_t GetWorkerCount() const;
+
+private:
+    // Body of a worker thread
+    void Work();
+
+    // Claim and run tasks of the current batch until none is left
+    void RunTasks();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable batch_ready_;
+    std::condition_variable batch_done_;
+    std::function<void(std::size_t)> task_;
+    std::size_t task_count_;
+    std::atomic<std::size_t> next_task_;
+    std::size_t generation_;
+    std::size_t done_workers_;  // Workers through the current batch
+    bool is_running_;
+
+};
+
+/**
+ * Risk of the whole book as computed by a ScenarioRiskEngine.
+ * PV01 and key-rate PV01 are value gained per basis point fall in yields.
+ */
+struct RiskSnapshot
+{
+    std::uint64_t version = 0;          // Position updates included
+    double portfolio_pv01 = 0.;
+    std::vector<double> key_rate_pv01;  // Per key rate
+    std::vector<double> scenario_pnl;   // Per scenario
+    std::size_t worst_scenario = 0;     // Scenario with the lowest P&L
+};
+
+/**
+ * Batch risk engine recomputing portfolio PV01, key-rate PV01 and the P&L of a grid
+ * of curve scenarios whenever positions change.
+ * Products, their PV01 and key-rate sensitivities are laid out as structures of
+ * arrays, one contiguous array per quantity. The scenario kernel walks the scenarios
+ * as contiguous arrays too, in blocks shared out to a WorkerPool, so its inner loop
+ * has no branches and vectorizes.
+ * Positions come in from the position pipeline through UpdatePosition(), which only
+ * stores the quantity and wakes the engine thread. That thread recomputes from the
+ * latest quantities, so a burst of trades costs one recompute and never waits on it.
+ * Readers take the latest RiskSnapshot from any thread.
+ * Type T is the product type.
+ */
+template<typename T>
+class ScenarioRiskEngine
+{
+
+public:
+
+    // ctor for an engine over the given key-rate tenors (years, ascending),
+    // computing scenarios on the calling thread and worker_count workers
+    ScenarioRiskEngine(std::vector<double> key_rate_tenors, std::size_t worker_count = 0);
+    ~ScenarioRiskEngine();
+
+    ScenarioRiskEngine(const ScenarioRiskEngine&) = delete;
+    ScenarioRiskEngine& operator = (const ScenarioRiskEngine&) = delete;
+
+    // Add a product maturing in tenor years, with its PV01 and convexity (value per
+    // basis point squared) per unit, before Start()
+    // Its sensitivities go to the two key rates around its tenor
+    void AddProduct(ProductHandle product, double tenor, double pv01, double gamma = 0.);
+
+    // Set the scenarios to price, before Start()
+    void SetScenarios(const std::vector<CurveScenario>& scenarios);
+
+    // Set the position of a product, from any thread, ignored for products not added
+    void UpdatePosition(ProductHandle product, long quantity);
+
+    // Recompute the snapshot from the current positions on the calling thread
+    void Recompute();
+
+    // Start the engine thread recomputing after position updates, once the flat book
+    // is priced, so a snapshot always covers every scenario
+    void Start();
+
+    // Recompute whatever is pending, then stop the engine thread
+    void Stop();
+
+    // Get the latest snapshot, from any thread
+    std::shared_ptr<const RiskSnapshot> GetSnapshot() const;
+
+    // Get the scenarios priced
+    CurveScenario GetScenario(std::size_t index) const;
+
+    // Get the number of scenarios priced
+    std::size_t GetScenarioCount() const;
+
+private:
+    static constexpr std::size_t kNoSlot = std::numeric_limits<std::size_t>::max();
+    static constexpr std::size_t kScenariosPerTask = 2048;
+
+    // P&L of scenarios [begin, end) given the key-rate PV01 and convexity of the book
+    void PriceScenarios(std::size_t begin, std::size_t end, const double* key_rate_pv01, const double* key_rate_gamma, double* pnl) const;
+
+    // Body of the engine thread
+    void Run();
+
+    std::vector<double> tenors_;
+    std::vector<double> twist_loadings_;      // Per key rate
+    std::vector<double> butterfly_loadings_;  // Per key rate
+
+    // Products, one entry each
+    std::vector<std::size_t> slots_;  // Index of each product handle
+    std::vector<double> pv01s_;
+    std::vector<std::vector<double>> key_rate_pv01s_;   // Per key rate, then per product
+    std::vector<std::vector<double>> key_rate_gammas_;  // Per key rate, then per product
+    std::deque<std::atomic<long>> quantities_;
+
+    // Scenarios, one entry each
+    std::vector<double> parallel_;
+    std::vector<double> twist_;
+    std::vector<double> butterfly_;
+
+    WorkerPool pool_;
+    std::shared_ptr<const RiskSnapshot> snapshot_;
+    std::atomic<std::uint64_t> version_;
+    std::atomic<bool> is_dirty_;
+    std::atomic<bool> is_running_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::thread thread_;
+
+};
+
+template<typename T>
+class PositionToScenarioRiskListener final : public ServiceListener<Position<T>>
+{
+
+public:
+
+    PositionToScenarioRiskListener(ScenarioRiskEngine<T>* _engine);
+    ~PositionToScenarioRiskListener() = default;
+
+    // Listener callback to process an add event to the Service
+    virtual void ProcessAdd(Position<T> &data) override;
+
+    // Listener callback to process a remove event to the Service
+    virtual void ProcessRemove(Position<T> &data) override;
+
+    // Listener callback to process an update event to the Service
+    virtual void ProcessUpdate(Position<T> &data) override;
+
+private:
+    ScenarioRiskEngine<T>* engine_;
+
+};
+
+std::vector<CurveScenario> MakeShockGrid(double max_bp, std::size_t steps) {
+    steps = std::max<std::size_t>(1, steps);
+    std::vector<double> shifts(steps, 0.);
+    for (std::size_t i = 0; i < steps && steps > 1; i++) {
+        shifts[i] = -max_bp + 2. * max_bp * double(i) / double(steps - 1);
+    }
+
+    std::vector<CurveScenario> scenarios;
+    scenarios.reserve(steps * steps * steps);
+    for (double parallel : shifts) {
+        for (double twist : shifts) {
+            for (double butterfly : shifts) {
+                scenarios.push_back({ parallel, twist, butterfly });
+            }
+        }
+    }
+    return scenarios;
+}
+
+WorkerPool::WorkerPool(std::size_t worker_count) :
+    task_count_(0), next_task_(0), generation_(0), done_workers_(0), is_running_(true) {
+    for (std::size_t i = 0; i < worker_count; i++) {
+        workers_.emplace_back(&WorkerPool::Work, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_running_ = false;
+    }
+    batch_ready_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void WorkerPool::RunTasks() {
+    std::size_t index;
+    while ((index = next_task_.fetch_add(1, std::memory_order_relaxed)) < task_count_) {
+        task_(index);
+    }
+}
+
+void WorkerPool::Work() {
+    std::size_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            batch_ready_.wait(lock, [&]() { return !is_running_ || generation_ != generation; });
+            if (!is_running_) return;
+            generation = generation_;
+        }
+        this->RunTasks();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (++done_workers_ < workers_.size()) continue;
+        }
+        batch_done_.notify_one();
+    }
+}
+
+void WorkerPool::Run(std::size_t task_count, std::function<void(std::size_t)> task) {
+    if (task_count == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = std::move(task);
+        task_count_ = task_count;
+        next_task_.store(0, std::memory_order_relaxed);
+        done_workers_ = 0;
+        generation_++;
+    }
+    batch_ready_.notify_all();
+
+    this->RunTasks();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    batch_done_.wait(lock, [&]() { return done_workers_ == workers_.size(); });
+    task_ = nullptr;
+}
+
+std::size_t WorkerPool::GetWorkerCount() const {
+    return this->workers_.size();
+}
+
+template<typename T>
+ScenarioRiskEngine<T>::ScenarioRiskEngine(std::vector<double> key_rate_tenors, std::size_t worker_count) :
+    tenors_(std::move(key_rate_tenors)), key_rate_pv01s_(tenors_.size()), key_rate_gammas_(tenors_.size()),
+    pool_(worker_count), snapshot_(std::make_shared<RiskSnapshot>()), version_(0), is_dirty_(false), is_running_(false) {
+    if (tenors_.empty() || !std::is_sorted(tenors_.begin(), tenors_.end())) {
+        throw std::invalid_argument("ScenarioRiskEngine: key-rate tenors must be ascending");
+    }
+
+    // Loadings on log tenor, -1 at the shortest key rate and +1 at the longest
+    double low = std::log(tenors_.front());
+    double high = std::log(tenors_.back());
+    for (double tenor : tenors_) {
+        double x = (high > low) ? 2. * (std::log(tenor) - low) / (high - low) - 1. : 0.;
+        twist_loadings_.push_back(x);
+        butterfly_loadings_.push_back(2. * std::fabs(x) - 1.);
+    }
+}
+
+template<typename T>
+ScenarioRiskEngine<T>::~ScenarioRiskEngine() {
+    this->Stop();
+}
+
+template<typename T>
+void ScenarioRiskEngine<T>::AddProduct(ProductHandle product, double tenor, double pv01, double gamma) {
+    if (product >= slots_.size()) slots_.resize(std::size_t(product) + 1, kNoSlot);
+    if (slots_[product] != kNoSlot) return;
+    slots_[product] = pv01s_.size();
+    pv01s_.push_back(pv01);
+    quantities_.emplace_back(0);
+
+    // Split between the key rates around the tenor, all on the nearest one outside the range
+    std::size_t upper = std::size_t(std::lower_bound(tenors_.begin(), tenors_.end(), tenor) - tenors_.begin());
+    std::size_t lower = (upper == 0) ? 0 : upper - 1;
+    upper = std::min(upper, tenors_.size() - 1);
+    double upper_weight = (upper == lower) ? 1. : (tenor - tenors_[lower]) / (tenors_[upper] - tenors_[lower]);
+    upper_weight = std::min(1., std::max(0., upper_weight));
+    for (std::size_t k = 0; k < tenors_.size(); k++) {
+        double weight = (k == upper ? upper_weight : 0.) + (k == lower && lower != upper ? 1. - upper_weight : 0.);
+        key_rate_pv01s_[k].push_back(weight * pv01);
+        key_rate_gammas_[k].push_back(weight * gamma);
+    }
+}
+
+template<typename T>
+void ScenarioRiskEngine<T>::SetScenarios(const std::vector<CurveScenario>& scenarios) {
+    parallel_.clear();
+    twist_.clear();
+    butterfly_.clear();
+    for (const auto& scenario : scenarios) {
+        parallel_.push_back(scenario.parallel);
+        twist_.push_back(scenario.twist);
+        butterfly_.push_back(scenario.butterfly);
+    }
+}
+
+template<typename T>
+void ScenarioRiskEngine<T>::UpdatePosition(ProductHandle product, long quantity) {
+    if (product >= slots_.size() || slots_[product] == kNoSlot) return;
+    quantities_[slots_[product]].store(quantity, std::memory_order_relaxed);
+    version_.fetch_add(1, std::memory_order_release);
+
+    // Only the update that finds the engine clean pays for the wake up
+    if (!is_dirty_.exchange(true, std::memory_order_acq_rel)) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_.notify_one();
+    }
+}
+
+template<typename T>
+void ScenarioRiskEngine<T>::PriceScenarios(std::size_t begin, std::size_t end, const double* key_rate_pv01, const double* key_rate_gamma, double* pnl) const {
+    const double* parallel = parallel_.data();
+    const double* twist = twist_.data();
+    const double* butterfly = butterfly_.data();
+    for (std::size_t s = begin; s < end; s++) {
+        pnl[s] = 0.;
+    }
+
+    // One pass per key rate over contiguous scenarios
+    for (std::size_t k = 0; k < tenors_.size(); k++) {
+        double twist_loading = twist_loadings_[k];
+        double butterfly_loading = butterfly_loadings_[k];
+        double pv01 = key_rate_pv01[k];
+        double half_gamma = 0.5 * key_rate_gamma[k];
+        for (std::size_t s = begin; s < end; s++) {
+            double shift = parallel[s] + twist_loading * twist[s] + butterfly_loading * butterfly[s];
+            pnl[s] += shift * (half_gamma * shift - pv01);
+        }
+    }
+}
+
+template<typename T>
+void ScenarioRiskEngine<T>::Recompute() {
+    auto snapshot = std::make_shared<RiskSnapshot>();
+    snapshot->version = version_.load(std::memory_order_acquire);
+
+    std::size_t product_count = pv01s_.size();
+    std::vector<double> quantities(product_count);
+    for (std::size_t i = 0; i < product_count; i++) {
+        quantities[i] = double(quantities_[i].load(std::memory_order_relaxed));
+    }
+
+    // Book sensitivities, one dot product per key rate
+    for (std::size_t i = 0; i < product_count; i++) {
+        snapshot->portfolio_pv01 += quantities[i] * pv01s_[i];
+    }
+    std::vector<double> key_rate_gamma(tenors_.size(), 0.);
+    snapshot->key_rate_pv01.assign(tenors_.size(), 0.);
+    for (std::size_t k = 0; k < tenors_.size(); k++) {
+        for (std::size_t i = 0; i < product_count; i++) {
+            snapshot->key_rate_pv01[k] += quantities[i] * key_rate_pv01s_[k][i];
+            key_rate_gamma[k] += quantities[i] * key_rate_gammas_[k][i];
+        }
+    }
+
+    // Scenario P&L, in blocks over the pool
+    std::size_t scenario_count = parallel_.size();
+    snapshot->scenario_pnl.resize(scenario_count);
+    const double* key_rate_pv01 = snapshot->key_rate_pv01.data();
+    double* pnl = snapshot->scenario_pnl.data();
+    std::size_t task_count = (scenario_count + kScenariosPerTask - 1) / kScenariosPerTask;
+    pool_.Run(task_count, [&](std::size_t task) {
+        std::size_t begin = task * kScenariosPerTask;
+        this->PriceScenarios(begin, std::min(begin + kScenariosPerTask, scenario_count), key_rate_pv01, key_rate_gamma.data(), pnl);
+    });
+    if (scenario_count > 0) {
+        snapshot->worst_scenario = std::size_t(std::min_element(pnl, pnl + scenario_count) - pnl);
+    }
+
+    std::atomic_store_explicit(&snapshot_, std::shared_ptr<const RiskSnapshot>(std::move(snapshot)), std::memory_order_release);
+}
+
+template<typename T>
+void ScenarioRiskEngine<T>::Start() {
+    if (is_running_.exchange(true)) return;
+    this->Recompute();
+    thread_ = std::thread(&ScenarioRiskEngine<T>::Run, this);
+}
+
+template<typename T>
+void ScenarioRiskEngine<T>::Stop() {
+    if (!is_running_.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_.notify_one();
+    }
+    thread_.join();
+}
+
+template<typename T>
+void ScenarioRiskEngine<T>::Run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_.wait(lock, [&]() {
+                return is_dirty_.load(std::memory_order_acquire) || !is_running_.load(std::memory_order_acquire);
+            });
+        }
+        // Updates landing from here on mark the engine dirty again
+        if (is_dirty_.exchange(false, std::memory_order_acq_rel)) {
+            this->Recompute();
+        } else if (!is_running_.load(std::memory_order_acquire)) {
+            return;
+        }
+    }
+}
+
+template<typename T>
+std::shared_ptr<const RiskSnapshot> ScenarioRiskEngine<T>::GetSnapshot() const {
+    return std::atomic_load_explicit(&snapshot_, std::memory_order_acquire);
+}
+
+template<typename T>
+CurveScenario ScenarioRiskEngine<T>::GetScenario(std::size_t index) const {
+    return { parallel_.at(index), twist_.at(index), butterfly_.at(index) };
+}
+
+template<typename T>
+std::size_t ScenarioRiskEngine<T>::GetScenarioCount() const {
+    return this->parallel_.size();
+}
+
+template<typename T>
+PositionToScenarioRiskListener<T>::PositionToScenarioRiskListener(ScenarioRiskEngine<T>* _engine) : engine_(_engine) {}
+
+template<typename T>
+void PositionToScenarioRiskListener<T>::ProcessAdd(Position<T>& data) {
+    this->engine_->UpdatePosition(data.GetProductHandle(), data.GetAggregatePosition());
+}
+
+template<typename T>
+void PositionToScenarioRiskListener<T>::ProcessRemove(Position<T>& data) {}
+
+template<typename T>
+void PositionToScenarioRiskListener<T>::ProcessUpdate(Position<T>& data) {}
+
+#endif
@@ -0,0 +1,233 @@
+
+#ifndef ShardedIngestion_HPP
+#define ShardedIngestion_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "soa.hpp"
+#include "mappedFile.hpp"
+#include "latencyMonitor.hpp"
+#include "pipelineStage.hpp"
+
+// Split data into at most chunk_count chunks of about equal size, cut between records
+// of lines_per_record non-empty lines
+std::vector<std::string_view> SplitRecords(std::string_view data, std::size_t chunk_count, std::size_t lines_per_record = 1);
+
+/**
+ * Parallel ingestion of one input file.
+ * The file is split into chunks on record boundaries and a pool of parser threads
+ * parses the chunks. Each parsed record goes to the shard of its product, and one
+ * thread per shard hands its records to the service graph, chunk after chunk.
+ * Ordering: records of one product always meet the same shard and the shard walks
+ *   chunks in file order, so every product sees its records in file order. No order
+ *   is defined between products of different shards.
+ * Shards run downstream code concurrently, so it must only share per-product state
+ * (ProductTable), atomics, or StageListeners with a ring per shard.
+ * Type R is the parsed record type, it must be default constructible and movable.
+ */
+template<typename R>
+class ShardedIngestor
+{
+
+public:
+
+    // ctor for an ingestor with the given number of parser threads and shards,
+    // a record spanning lines_per_record non-empty lines
+    ShardedIngestor(std::size_t _parser_count, std::size_t _shard_count, std::size_t _lines_per_record = 1);
+
+    // Parse and dispatch a whole file, rethrows the first parse or dispatch error
+    // parse(record, parsed) fills parsed from the lines of one record and returns its product
+    // handle(parsed) dispatches one parsed record, on the thread of its shard
+    template<typename Parser, typename Handler>
+    void Ingest(std::string_view data, Parser parse, Handler handle);
+
+    // Get the number of records dispatched by the last Ingest()
+    std::size_t GetRecordCount() const;
+
+    // Get the number of parser threads
+    std::size_t GetParserCount() const;
+
+    // Get the number of shards
+    std::size_t GetShardCount() const;
+
+private:
+    static const std::size_t kChunksPerParser = 4;
+
+    struct Chunk
+    {
+        std::string_view data;
+        std::vector<std::vector<R>> shards;
+        std::atomic<bool> is_parsed{ false };
+    };
+
+    // Keep the first error and stop every thread
+    void Fail(std::exception_ptr error);
+
+    std::size_t parser_count_;
+    std::size_t shard_count_;
+    std::size_t lines_per_record_;
+    std::atomic<std::size_t> record_count_;
+    std::atomic<bool> has_failed_;
+    std::exception_ptr error_;
+    std::mutex error_mutex_;
+
+};
+
+std::vector<std::string_view> SplitRecords(std::string_view data, std::size_t chunk_count, std::size_t lines_per_record) {
+    std::vector<std::string_view> chunks;
+    if (data.empty()) return chunks;
+    chunk_count = std::max<std::size_t>(1, chunk_count);
+    lines_per_record = std::max<std::size_t>(1, lines_per_record);
+    std::size_t target = data.size() / chunk_count + 1;
+
+    std::size_t start = 0;
+    if (lines_per_record == 1) {
+        // Any line ends a record, cut at the first line end past the target size
+        while (start < data.size()) {
+            std::size_t cut = start + target;
+            if (cut < data.size()) {
+                std::size_t newline = data.find('\n', cut - 1);
+                cut = (newline == std::string_view::npos) ? data.size() : newline + 1;
+            } else {
+                cut = data.size();
+            }
+            chunks.push_back(data.substr(start, cut - start));
+            start = cut;
+        }
+        return chunks;
+    }
+
+    // Count non-empty lines to cut only where a record ends
+    std::size_t pos = 0;
+    std::size_t lines = 0;
+    while (pos < data.size()) {
+        std::size_t end = data.find('\n', pos);
+        end = (end == std::string_view::npos) ? data.size() : end + 1;
+        if (data[pos] != '\n' && data[pos] != '\r') lines++;
+        pos = end;
+        if (pos - start >= target && lines % lines_per_record == 0) {
+            chunks.push_back(data.substr(start, pos - start));
+            start = pos;
+        }
+    }
+    if (start < data.size()) chunks.push_back(data.substr(start));
+    return chunks;
+}
+
+template<typename R>
+ShardedIngestor<R>::ShardedIngestor(std::size_t _parser_count, std::size_t _shard_count, std::size_t _lines_per_record) :
+    parser_count_(std::max<std::size_t>(1, _parser_count)), shard_count_(std::max<std::size_t>(1, _shard_count)),
+    lines_per_record_(std::max<std::size_t>(1, _lines_per_record)), record_count_(0), has_failed_(false) {}
+
+template<typename R>
+void ShardedIngestor<R>::Fail(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (!error_) error_ = error;
+    has_failed_.store(true, std::memory_order_release);
+}
+
+template<typename R>
+template<typename Parser, typename Handler>
+void ShardedIngestor<R>::Ingest(std::string_view data, Parser parse, Handler handle) {
+    std::vector<std::string_view> views = SplitRecords(data, parser_count_ * kChunksPerParser, lines_per_record_);
+    std::unique_ptr<Chunk[]> chunks(new Chunk[views.size()]);
+    for (std::size_t i = 0; i < views.size(); i++) {
+        chunks[i].data = views[i];
+        chunks[i].shards.resize(shard_count_);
+    }
+    record_count_.store(0, std::memory_order_relaxed);
+    has_failed_.store(false, std::memory_order_relaxed);
+    error_ = nullptr;
+
+    // Parsers claim chunks in file order, so the shards can start on the first ones early
+    std::atomic<std::size_t> next_chunk(0);
+    auto run_parser = [&]() {
+        std::size_t index;
+        while ((index = next_chunk.fetch_add(1, std::memory_order_relaxed)) < views.size()) {
+            Chunk& chunk = chunks[index];
+            try {
+                if (!has_failed_.load(std::memory_order_acquire)) {
+                    LineReader reader(chunk.data);
+                    std::string_view line;
+                    const char* record_start = nullptr;
+                    std::size_t lines = 0;
+                    while (reader.Next(line)) {
+                        if (line.empty()) continue;
+                        if (lines++ == 0) record_start = line.data();
+                        if (lines < lines_per_record_) continue;
+
+                        R parsed;
+                        std::string_view record(record_start, std::size_t(line.data() + line.size() - record_start));
+                        ProductHandle product = parse(record, parsed);
+                        chunk.shards[product % shard_count_].push_back(std::move(parsed));
+                        lines = 0;
+                    }
+                }
+            } catch (...) {
+                this->Fail(std::current_exception());
+            }
+            chunk.is_parsed.store(true, std::memory_order_release);
+        }
+    };
+
+    auto run_shard = [&](std::size_t shard) {
+        SetProducerSlot(shard);
+        try {
+            for (std::size_t index = 0; index < views.size(); index++) {
+                Chunk& chunk = chunks[index];
+                unsigned idle_rounds = 0;
+                while (!chunk.is_parsed.load(std::memory_order_acquire)) {
+                    WaitBackoff(idle_rounds);
+                }
+                if (has_failed_.load(std::memory_order_acquire)) return;
+
+                std::vector<R>& records = chunk.shards[shard];
+                for (R& record : records) {
+                    StampIngress();
+                    handle(record);
+                }
+                record_count_.fetch_add(records.size(), std::memory_order_relaxed);
+                std::vector<R>().swap(records);
+            }
+        } catch (...) {
+            this->Fail(std::current_exception());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < std::min(parser_count_, views.size()); i++) {
+        threads.emplace_back(run_parser);
+    }
+    for (std::size_t shard = 0; shard < shard_count_; shard++) {
+        threads.emplace_back(run_shard, shard);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (error_) std::rethrow_exception(error_);
+}
+
+template<typename R>
+std::size_t ShardedIngestor<R>::GetRecordCount() const {
+    return this->record_count_.load(std::memory_order_relaxed);
+}
+
+template<typename R>
+std::size_t ShardedIngestor<R>::GetParserCount() const {
+    return this->parser_count_;
+}
+
+template<typename R>
+std::size_t ShardedIngestor<R>::GetShardCount() const {
+    return this->shard_count_;
+}
+
+#endif
@@ -2,8 +2,15 @@
 #ifndef SOA_HPP
 #define SOA_HPP
 
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <fstream>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include "mappedFile.hpp"
+#include "productRegistry.hpp"
 
 using namespace std;
 
@@ -17,6 +24,9 @@ class ServiceListener
 {
 
 public:
+    // Type of the data this listener consumes
+    typedef V ValueType;
+
     virtual ~ServiceListener() = default;
 
     // Listener callback to process an add event to the Service
@@ -49,6 +59,10 @@ public:
     // The callback that a Connector should invoke for any new or updated data
     virtual void OnMessage(V &data) = 0;
 
+    // The callback for data the caller hands over, services storing it override this
+    // to move it in instead of copying
+    virtual void OnMessage(V &&data) { this->OnMessage(data); }
+
     // Add a listener to the Service for callbacks on add, remove, and update events
     // for data to the Service.
     virtual void AddListener(ServiceListener<V> *listener) = 0;
@@ -79,8 +93,236 @@ public:
     // Subscribe data from the Connector
     virtual void Subscribe(ifstream& data) = 0;
 
+    // Subscribe data from a memory-mapped file without copying lines
+    virtual void Subscribe(const MappedFile& data) = 0;
+
+};
+
+/**
+ * A ServiceListener fanning out to a set of listeners fixed at compile time.
+ * The graph of services is wired once at startup, so instead of registering
+ * each listener with AddListener, a service can be given a single chain whose
+ * listener types are concrete. The service still reaches the chain through one
+ * virtual ProcessAdd, but the fan-out behind it is direct, inlinable calls rather
+ * than a virtual call per listener. A hop to a single listener costs the same
+ * either way, the saving grows with the listeners of a service.
+ * Uses value generic type V and concrete listener types Listeners.
+ */
+template<typename V, typename... Listeners>
+class StaticListenerChain final : public ServiceListener<V>
+{
+
+public:
+
+    // ctor for a chain over the given listeners, notified in order
+    StaticListenerChain(Listeners*... listeners);
+
+    // Forward an add event to every listener in the chain
+    virtual void ProcessAdd(V &data) override;
+
+    // Forward a remove event to every listener in the chain
+    virtual void ProcessRemove(V &data) override;
+
+    // Forward an update event to every listener in the chain
+    virtual void ProcessUpdate(V &data) override;
+
+private:
+    tuple<Listeners*...> listeners_;
+
+};
+
+// Build a chain over listeners consuming the same data type
+template<typename Listener, typename... Listeners>
+StaticListenerChain<typename Listener::ValueType, Listener, Listeners...> MakeListenerChain(Listener* listener, Listeners*... listeners)
+{
+    return StaticListenerChain<typename Listener::ValueType, Listener, Listeners...>(listener, listeners...);
+}
+
+template<typename V, typename... Listeners>
+StaticListenerChain<V, Listeners...>::StaticListenerChain(Listeners*... listeners) : listeners_(listeners...) {}
+
+template<typename V, typename... Listeners>
+void StaticListenerChain<V, Listeners...>::ProcessAdd(V &data) {
+    // Qualified calls bypass the vtable
+    apply([&data](Listeners*... listeners) { (listeners->Listeners::ProcessAdd(data), ...); }, listeners_);
+}
+
+template<typename V, typename... Listeners>
+void StaticListenerChain<V, Listeners...>::ProcessRemove(V &data) {
+    apply([&data](Listeners*... listeners) { (listeners->Listeners::ProcessRemove(data), ...); }, listeners_);
+}
+
+template<typename V, typename... Listeners>
+void StaticListenerChain<V, Listeners...>::ProcessUpdate(V &data) {
+    apply([&data](Listeners*... listeners) { (listeners->Listeners::ProcessUpdate(data), ...); }, listeners_);
+}
+
+/**
+ * Dense per-product state for a Service, indexed by ProductHandle.
+ * The traded universe is small and fixed, so a lookup is an array index
+ * instead of hashing a key. Each slot is padded to its own cache line so
+ * updates to different products never share a line.
+ * Slots live in fixed blocks that are published atomically and never move, so
+ * threads may work on different products concurrently, as sharded ingestion does.
+ * Uses value generic type V, which must be default constructible.
+ */
+template<typename V>
+class ProductTable
+{
+
+public:
+
+    ProductTable();
+    ~ProductTable();
+
+    ProductTable(const ProductTable&) = delete;
+    ProductTable& operator = (const ProductTable&) = delete;
+
+    // Get the value of a product, default-constructing it on first access
+    V& operator [] (ProductHandle handle);
+
+    // Get the value of a product, throws out_of_range if it has never been set
+    V& At(ProductHandle handle);
+    const V& At(ProductHandle handle) const;
+
+    // Whether a value has been set for a product
+    bool Contains(ProductHandle handle) const;
+
+    // Set the value of a product, returns the stored value
+    V& InsertOrAssign(ProductHandle handle, const V& value);
+    V& InsertOrAssign(ProductHandle handle, V&& value);
+
+    // Construct the value of a product from args unless it is already set
+    template<typename... Args>
+    V& TryEmplace(ProductHandle handle, Args&&... args);
+
+    // Get the number of slots, set or not
+    std::size_t GetSize() const;
+
+private:
+    static const std::size_t kCacheLineSize = 64;
+    static const std::size_t kSlotsPerBlock = 64;
+    static const std::size_t kMaxBlocks = 4096;
+
+    struct alignas(kCacheLineSize) Slot
+    {
+        V value;
+        bool is_set = false;
+    };
+
+    // Get the slot of a handle, allocating its block on first access
+    Slot& GetSlot(ProductHandle handle);
+
+    // Get the slot of a handle, nullptr if its block does not exist
+    const Slot* FindSlot(ProductHandle handle) const;
+
+    unique_ptr<atomic<Slot*>[]> blocks_;
+    atomic<std::size_t> block_count_;
+
 };
 
+template<typename V>
+ProductTable<V>::ProductTable() : blocks_(new atomic<Slot*>[kMaxBlocks]), block_count_(0) {
+    for (std::size_t i = 0; i < kMaxBlocks; i++) {
+        blocks_[i].store(nullptr, memory_order_relaxed);
+    }
+}
+
+template<typename V>
+ProductTable<V>::~ProductTable() {
+    for (std::size_t i = 0; i < kMaxBlocks; i++) {
+        delete[] blocks_[i].load(memory_order_relaxed);
+    }
+}
+
+template<typename V>
+typename ProductTable<V>::Slot& ProductTable<V>::GetSlot(ProductHandle handle) {
+    if (handle == kInvalidProductHandle || handle / kSlotsPerBlock >= kMaxBlocks) {
+        throw out_of_range("ProductTable: invalid product handle");
+    }
+    atomic<Slot*>& block = blocks_[handle / kSlotsPerBlock];
+    Slot* slots = block.load(memory_order_acquire);
+    if (slots == nullptr) {
+        // Two threads may race to open a block, the loser frees its copy
+        Slot* fresh = new Slot[kSlotsPerBlock];
+        if (block.compare_exchange_strong(slots, fresh, memory_order_acq_rel)) {
+            slots = fresh;
+            block_count_.fetch_add(1, memory_order_relaxed);
+        } else {
+            delete[] fresh;
+        }
+    }
+    return slots[handle % kSlotsPerBlock];
+}
+
+template<typename V>
+const typename ProductTable<V>::Slot* ProductTable<V>::FindSlot(ProductHandle handle) const {
+    if (handle / kSlotsPerBlock >= kMaxBlocks) return nullptr;
+    const Slot* slots = blocks_[handle / kSlotsPerBlock].load(memory_order_acquire);
+    return slots == nullptr ? nullptr : &slots[handle % kSlotsPerBlock];
+}
+
+template<typename V>
+V& ProductTable<V>::operator [] (ProductHandle handle) {
+    Slot& slot = this->GetSlot(handle);
+    slot.is_set = true;
+    return slot.value;
+}
+
+template<typename V>
+V& ProductTable<V>::At(ProductHandle handle) {
+    if (!this->Contains(handle)) {
+        throw out_of_range("ProductTable: product has no value");
+    }
+    return this->GetSlot(handle).value;
+}
+
+template<typename V>
+const V& ProductTable<V>::At(ProductHandle handle) const {
+    if (!this->Contains(handle)) {
+        throw out_of_range("ProductTable: product has no value");
+    }
+    return this->FindSlot(handle)->value;
+}
+
+template<typename V>
+bool ProductTable<V>::Contains(ProductHandle handle) const {
+    const Slot* slot = this->FindSlot(handle);
+    return slot != nullptr && slot->is_set;
+}
+
+template<typename V>
+V& ProductTable<V>::InsertOrAssign(ProductHandle handle, const V& value) {
+    Slot& slot = this->GetSlot(handle);
+    slot.value = value;
+    slot.is_set = true;
+    return slot.value;
+}
+
+template<typename V>
+V& ProductTable<V>::InsertOrAssign(ProductHandle handle, V&& value) {
+    Slot& slot = this->GetSlot(handle);
+    slot.value = std::move(value);
+    slot.is_set = true;
+    return slot.value;
+}
+
+template<typename V>
+template<typename... Args>
+V& ProductTable<V>::TryEmplace(ProductHandle handle, Args&&... args) {
+    Slot& slot = this->GetSlot(handle);
+    if (!slot.is_set) {
+        slot.value = V(std::forward<Args>(args)...);
+        slot.is_set = true;
+    }
+    return slot.value;
+}
+
+template<typename V>
+std::size_t ProductTable<V>::GetSize() const {
+    return block_count_.load(memory_order_relaxed) * kSlotsPerBlock;
+}
+
 template<typename K, typename V>
 void Service<K, V>::AddListener(ServiceListener<V> *listener) {
     this->listeners_.push_back(listener);
@@ -18,8 +18,8 @@ class AlgoStreamingToStreamingListener;
 template<typename T>
 class StreamingService : public Service<string,PriceStream <T> > {
 private:
-    unordered_map<string, PriceStream<T>> price_streams_;
-    ServiceListener<AlgoStream<T>>* in_listener_;
+    ProductTable<PriceStream<T>> price_streams_;
+    AlgoStreamingToStreamingListener<T>* in_listener_;
 
 public:
     
@@ -40,7 +40,7 @@ public:
     virtual const vector<ServiceListener<PriceStream<T>>*>& GetListeners() const override;
     
     // Get the listener of the service
-    ServiceListener<AlgoStream<T>>* GetInListener();
+    AlgoStreamingToStreamingListener<T>* GetInListener();
 
     // Publish two-way prices
     void PublishPrice(PriceStream<T>& priceStream);
@@ -48,7 +48,7 @@ public:
 };
 
 template<typename T>
-class AlgoStreamingToStreamingListener : public ServiceListener<AlgoStream<T>> {
+class AlgoStreamingToStreamingListener final : public ServiceListener<AlgoStream<T>> {
 private:
     StreamingService<T>* service_;
     
@@ -78,13 +78,12 @@ StreamingService<T>::~StreamingService() {
 
 template <typename T>
 PriceStream<T>& StreamingService<T>::GetData(string product_id) {
-    return this->price_streams_[product_id];
+    return this->price_streams_[ProductRegistry<T>::Instance().Find(product_id)];
 }
 
 template <typename T>
 void StreamingService<T>::OnMessage(PriceStream<T>& data) {
-    string product_id = data.GetProduct().GetProductId();
-    this->price_streams_.insert_or_assign(product_id, data);
+    this->price_streams_.InsertOrAssign(data.GetProductHandle(), data);
 }
 
 template <typename T>
@@ -98,7 +97,7 @@ const vector<ServiceListener<PriceStream<T>>*>& StreamingService<T>::GetListener
 }
 
 template <typename T>
-ServiceListener<AlgoStream<T>>* StreamingService<T>::GetInListener() {
+AlgoStreamingToStreamingListener<T>* StreamingService<T>::GetInListener() {
     return this->in_listener_;
 }
 
@@ -3,10 +3,13 @@
 #define TradeBookingService_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include "soa.hpp"
+#include "bookRegistry.hpp"
 #include "executionService.hpp"
+#include "latencyMonitor.hpp"
 
 // Trade sides
 enum Side { BUY, SELL };
@@ -22,20 +25,28 @@ public:
 
     Trade() = default;
     // ctor for a trade
-    Trade(const T &_product, string _tradeId, double _price, string _book, long _quantity, Side _side);
+    Trade(const T &_product, string _tradeId, Ticks256 _price, string _book, long _quantity, Side _side);
+    Trade(ProductHandle _product, string _tradeId, Ticks256 _price, string_view _book, long _quantity, Side _side);
+    Trade(ProductHandle _product, string _tradeId, Ticks256 _price, BookHandle _book, long _quantity, Side _side);
 
     // Get the product
     const T& GetProduct() const;
 
+    // Get the interned product handle
+    ProductHandle GetProductHandle() const;
+
     // Get the trade ID
     const string& GetTradeId() const;
 
     // Get the mid price
-    double GetPrice() const;
+    Ticks256 GetPrice() const;
 
     // Get the book
     const string& GetBook() const;
 
+    // Get the interned book handle
+    BookHandle GetBookHandle() const;
+
     // Get the quantity
     long GetQuantity() const;
 
@@ -43,10 +54,10 @@ public:
     Side GetSide() const;
 
 private:
-    T product;
+    ProductHandle product = kInvalidProductHandle;
     string tradeId;
-    double price;
-    string book;
+    Ticks256 price;
+    BookHandle book = kInvalidBookHandle;
     long quantity;
     Side side;
 
@@ -80,6 +91,9 @@ public:
     
     // The callback that a Connector should invoke for any new or updated data
     virtual void OnMessage(Trade<T>& data) override;
+
+    // The callback for data the caller hands over, moved into the service
+    virtual void OnMessage(Trade<T>&& data) override;
     
     // Add a listener to the Service for callbacks on add, remove, and update events
     // for data to the Service.
@@ -116,13 +130,23 @@ public:
     // Subscribe data from the Connector
     virtual void Subscribe(ifstream& data) override;
 
+    // Subscribe data from a memory-mapped file
+    virtual void Subscribe(const MappedFile& data) override;
+
+    // Parse a single line and push it to the service
+    void ParseLine(string_view line);
+
+    // Parse a single non-empty line into a trade
+    Trade<T> Parse(string_view line) const;
+
 };
 
 template <typename T>
-class ExecutionToTradeBookingListener : public ServiceListener<ExecutionOrder<T>> {
+class ExecutionToTradeBookingListener final : public ServiceListener<ExecutionOrder<T>> {
 private:
     TradeBookingService<T>* service_;
     long count_;
+    BookHandle books_[3];  // Books the executions are booked into, in turn
     
 public:
     // Connector and Destructor
@@ -140,18 +164,31 @@ public:
 };
 
 template<typename T>
-Trade<T>::Trade(const T &_product, string _tradeId, double _price, string _book, long _quantity, Side _side) :
-  product(_product)
+Trade<T>::Trade(const T &_product, string _tradeId, Ticks256 _price, string _book, long _quantity, Side _side) :
+  Trade(ProductRegistry<T>::Instance().Intern(_product), std::move(_tradeId), _price, BookRegistry::Instance().Intern(_book), _quantity, _side)
+{
+}
+
+template<typename T>
+Trade<T>::Trade(ProductHandle _product, string _tradeId, Ticks256 _price, string_view _book, long _quantity, Side _side) :
+  Trade(_product, std::move(_tradeId), _price, BookRegistry::Instance().Intern(_book), _quantity, _side)
+{
+}
+
+template<typename T>
+Trade<T>::Trade(ProductHandle _product, string _tradeId, Ticks256 _price, BookHandle _book, long _quantity, Side _side) :
+  product(_product), tradeId(std::move(_tradeId)), price(_price), book(_book), quantity(_quantity), side(_side)
 {
-    tradeId = _tradeId;
-    price = _price;
-    book = _book;
-    quantity = _quantity;
-    side = _side;
 }
 
 template<typename T>
 const T& Trade<T>::GetProduct() const
+{
+    return ProductRegistry<T>::Instance().Get(this->product);
+}
+
+template<typename T>
+ProductHandle Trade<T>::GetProductHandle() const
 {
     return this->product;
 }
@@ -163,13 +200,19 @@ const string& Trade<T>::GetTradeId() const
 }
 
 template<typename T>
-double Trade<T>::GetPrice() const
+Ticks256 Trade<T>::GetPrice() const
 {
     return this->price;
 }
 
 template<typename T>
 const string& Trade<T>::GetBook() const
+{
+    return BookRegistry::Instance().Get(this->book);
+}
+
+template<typename T>
+BookHandle Trade<T>::GetBookHandle() const
 {
     return this->book;
 }
@@ -205,9 +248,7 @@ Trade<T>& TradeBookingService<T>::GetData(string product_id) {
 
 template <typename T>
 void TradeBookingService<T>::OnMessage(Trade<T>& data) {
-    string trade_id = data.GetTradeId();
-    
-    this->trades_.insert_or_assign(trade_id, data);
+    this->trades_.insert_or_assign(data.GetTradeId(), data);
     
     // Also notify listeners
     for (auto& listener : Service<string, Trade<T>>::listeners_) {
@@ -215,6 +256,20 @@ void TradeBookingService<T>::OnMessage(Trade<T>& data) {
     }
 }
 
+template <typename T>
+void TradeBookingService<T>::OnMessage(Trade<T>&& data) {
+    // A new entry copies its key from the trade before the trade is moved in,
+    // an existing one leaves the trade alone
+    auto [entry, is_new] = this->trades_.try_emplace(data.GetTradeId(), std::move(data));
+    if (!is_new) entry->second = std::move(data);
+    Trade<T>& trade = entry->second;
+    
+    // Also notify listeners
+    for (auto& listener : Service<string, Trade<T>>::listeners_) {
+        listener->ProcessAdd(trade);
+    }
+}
+
 template <typename T>
 void TradeBookingService<T>::AddListener(ServiceListener<Trade<T>>* listener) {
     this->Service<string, Trade<T>>::AddListener(listener);
@@ -254,32 +309,52 @@ template <typename T>
 void TradeBookingConnector<T>::Subscribe(ifstream& data) {
     string line;
     while (getline(data, line)) {
-        // Separate line with delimiter ','
-        stringstream line_stream(line);
-        string line_entry;
-        vector<string> line_entries;
-        while (getline(line_stream, line_entry, ',')) {
-            line_entries.push_back(line_entry);
-        }
-        
-        // Parse data into Trade
-        string product_id = line_entries[0];
-        string trade_id = line_entries[1];
-        double price = ConvertPrice(line_entries[2]);
-        string book = line_entries[3];
-        long quantity = stol(line_entries[4]);
-        Side side = (line_entries[5] == "BUY") ? BUY : SELL;
-        
-        T product = FetchBond(product_id);
-        Trade<T> trade(product, trade_id, price, book, quantity, side);
-        
-        // Notify connected service
-        this->service->OnMessage(trade);
+        this->ParseLine(line);
+    }
+}
+
+template <typename T>
+void TradeBookingConnector<T>::Subscribe(const MappedFile& data) {
+    LineReader reader(data.GetView());
+    string_view line;
+    while (reader.Next(line)) {
+        this->ParseLine(line);
     }
 }
 
 template <typename T>
-ExecutionToTradeBookingListener<T>::ExecutionToTradeBookingListener(TradeBookingService<T>* service) : service_(service), count_(0) {}
+void TradeBookingConnector<T>::ParseLine(string_view line) {
+    if (line.empty()) return;
+    StampIngress();
+    
+    // Notify connected service
+    this->service->OnMessage(this->Parse(line));
+}
+
+template <typename T>
+Trade<T> TradeBookingConnector<T>::Parse(string_view line) const {
+    // Separate line with delimiter ','
+    string_view line_entries[6];
+    SplitLine(line, line_entries, 6);
+    
+    // Parse data into Trade
+    ProductHandle product = FetchBondHandle(line_entries[0]);
+    string trade_id(line_entries[1]);
+    Ticks256 price = ConvertPrice(line_entries[2]);
+    BookHandle book = BookRegistry::Instance().Intern(line_entries[3]);
+    long quantity = ParseLong(line_entries[4]);
+    Side side = (line_entries[5] == "BUY") ? BUY : SELL;
+    
+    return Trade<T>(product, std::move(trade_id), price, book, quantity, side);
+}
+
+template <typename T>
+ExecutionToTradeBookingListener<T>::ExecutionToTradeBookingListener(TradeBookingService<T>* service) : service_(service), count_(0) {
+    BookRegistry& registry = BookRegistry::Instance();
+    books_[0] = registry.Intern("TRSY1");
+    books_[1] = registry.Intern("TRSY2");
+    books_[2] = registry.Intern("TRSY3");
+}
 
 template <typename T>
 void ExecutionToTradeBookingListener<T>::ProcessAdd(ExecutionOrder<T>& data) {
@@ -287,10 +362,9 @@ void ExecutionToTradeBookingListener<T>::ProcessAdd(ExecutionOrder<T>& data) {
     this->count_++;
     
     // Get data from execution order
-    T product = data.GetProduct();
+    ProductHandle product = data.GetProductHandle();
     PricingSide pricing_side = data.GetPricingSide();
-    string order_id = data.GetOrderId();
-    double price = data.GetPrice();
+    Ticks256 price = data.GetPrice();
     long visible_quantity = data.GetVisibleQuantity();
     long hidden_quantity = data.GetHiddenQuantity();
 
@@ -298,22 +372,10 @@ void ExecutionToTradeBookingListener<T>::ProcessAdd(ExecutionOrder<T>& data) {
     // Sell to bids and buy to offers
     Side side = (pricing_side == BID) ? SELL : BUY;
 
-    string book;
-    switch (count_ % 3)
-    {
-    case 0:
-        book = "TRSY1";
-        break;
-    case 1:
-        book = "TRSY2";
-        break;
-    case 2:
-        book = "TRSY3";
-        break;
-    }
+    BookHandle book = books_[count_ % 3];
     long quantity = visible_quantity + hidden_quantity;
 
-    Trade<T> trade(product, order_id, price, book, quantity, side);
+    Trade<T> trade(product, data.GetOrderId(), price, book, quantity, side);
     
     // Request connected service to book the trade
     this->service_->OnMessage(trade);
@@ -4,61 +4,102 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
 #include <utility>
 #include <map>
 #include "boost/date_time/gregorian/gregorian.hpp"
 #include <chrono>
 #include <ctime>
 #include "products.hpp"
+#include "priceTicks.hpp"
+#include "productRegistry.hpp"
+
+// Parse an integer field in place, without the temporary string stol needs
+long ParseLong(string_view str) {
+    long res = 0;
+    const char* end = str.data() + str.size();
+    auto [ptr, ec] = from_chars(str.data(), end, res);
+    if (ec != errc() || ptr != end) {
+        throw invalid_argument("ParseLong: invalid integer '" + string(str) + "'");
+    }
+    return res;
+}
 
-// Convert numeric price to bond notation
-float ConvertPrice(const string& str_price) {
-    // "100-xyz" -> 100 + xy / 32 + z / 256
-    auto delimiter_pos = str_price.find('-');
+// Parse bond notation "100-xyz" into 1/256 ticks without allocating
+// xy are 32nds (00-31), z is 256ths (0-7) or '+' for a half 32nd
+// Returns false on malformed input
+bool ParsePriceTicks(string_view str_price, long& ticks) {
+    std::size_t size = str_price.size();
+    std::size_t delimiter_pos = size - 4;
+    if (size < 5 || delimiter_pos > 4 || str_price[delimiter_pos] != '-') {
+        return false;
+    }
+    const char* p = str_price.data();
     
     // Integer
-    float res = stoi(str_price.substr(0, delimiter_pos));
+    long integer = 0;
+    unsigned invalid = 0;
+    for (std::size_t i = 0; i < delimiter_pos; i++) {
+        unsigned digit = unsigned(p[i] - '0');
+        invalid |= (digit > 9);
+        integer = integer * 10 + digit;
+    }
     
     // xy
-    res += stoi(str_price.substr(delimiter_pos + 1, 2)) / 32.;
+    unsigned x = unsigned(p[delimiter_pos + 1] - '0');
+    unsigned y = unsigned(p[delimiter_pos + 2] - '0');
+    unsigned thirty_seconds = x * 10 + y;
     
     // z
-    char last_char = str_price[delimiter_pos + 3];
-    if (last_char == '+') {
-        res += 1. / 64.;
-    } else {
-        res += (last_char - '0') / 256.;  // int('0') == 48
+    char last_char = p[delimiter_pos + 3];
+    unsigned z = (last_char == '+') ? 4u : unsigned(last_char - '0');
+    
+    invalid |= (x > 9) | (y > 9) | (thirty_seconds > 31) | (z > 7);
+    if (invalid) {
+        return false;
     }
-    return res;
+    
+    ticks = integer * Ticks256::kTicksPerPoint + thirty_seconds * 8 + z;
+    return true;
 }
 
-string ConvertPrice(float f_price) {
-    int integer = int(f_price);
-    string res = to_string(integer) + '-';
+// Convert bond notation to a tick price
+Ticks256 ConvertPrice(string_view str_price) {
+    long ticks = 0;
+    if (!ParsePriceTicks(str_price, ticks)) {
+        throw invalid_argument("ConvertPrice: invalid price '" + string(str_price) + "'");
+    }
+    return Ticks256(ticks);
+}
+
+// Convert a tick price to bond notation
+string ConvertPrice(Ticks256 price) {
+    // ticks -> 100 + xy / 32 + z / 256
+    long ticks = price.GetTicks();
+    long integer = ticks / Ticks256::kTicksPerPoint;
+    long remainder = ticks % Ticks256::kTicksPerPoint;
+    long thirty_seconds = remainder / 8;
+    long z = remainder % 8;
     
-    f_price -= integer;
-    f_price *= 32.;
-    integer = int(f_price);
-    if (integer < 10) {
+    string res = to_string(integer) + '-';
+    if (thirty_seconds < 10) {
         // Pad with 0 if only one digit
         res += '0';
     }
+    res += to_string(thirty_seconds);
     
-    res += to_string(integer);
-    
-    f_price -= integer;
-    f_price *= 8.;
-    integer = int(f_price);
-    if (integer == 4.) {
+    if (z == 4) {
         res += '+';
     } else {
-        res += to_string(integer);
+        res += char('0' + z);
     }
     
     return res;
 }
 
-
 std::map<int, std::pair<string, boost::gregorian::date>> kBondMapMaturity({
     {2, {"BONDNO1", {2025, boost::gregorian::Nov, 30}}},
     {3, {"BONDNO2", {2026, boost::gregorian::Nov, 15}}},
@@ -79,41 +120,58 @@ std::map<string, std::pair<int, boost::gregorian::date>> kBondMapCusip({
     {"BONDNO7", {30, {2053, boost::gregorian::Nov, 15}}}
 });
 
-std::map<std::string, double> kPV01Map({
-    {"BONDNO1", 0.019851},
-    {"BONDNO2", 0.029309},
-    {"BONDNO3", 0.048643},
-    {"BONDNO4", 0.065843},
-    {"BONDNO5", 0.087939},
-    {"BONDNO6", 0.012346},
-    {"BONDNO7", 0.018469}
+// Annual coupons in percent of the on-the-run bonds
+std::map<string, float> kBondCoupon({
+    {"BONDNO1", 4.875f},
+    {"BONDNO2", 4.625f},
+    {"BONDNO3", 4.375f},
+    {"BONDNO4", 4.375f},
+    {"BONDNO5", 4.5f},
+    {"BONDNO6", 4.75f},
+    {"BONDNO7", 4.75f}
 });
 
+// Settlement date the on-the-run bonds are risked as of
+const boost::gregorian::date kSettlementDate(2023, boost::gregorian::Dec, 1);
+
 
 // Fetch cusip object from maturity (years)
 string FetchCusip(int maturity) {
     return kBondMapMaturity[maturity].first;
 }
 
-Bond FetchBond(int maturity) {
-    return Bond(kBondMapMaturity[maturity].first, CUSIP, "US" + to_string(maturity) + "Y", 0., kBondMapMaturity[maturity].second);
+// Intern every on-the-run bond once, in maturity order
+bool RegisterBonds() {
+    ProductRegistry<Bond>& registry = ProductRegistry<Bond>::Instance();
+    for (const auto& [maturity, bond] : kBondMapMaturity) {
+        registry.Intern(Bond(bond.first, CUSIP, "US" + to_string(maturity) + "Y", kBondCoupon.at(bond.first), bond.second));
+    }
+    return true;
 }
 
-Bond FetchBond(const string& cusip) {
-    return Bond(cusip, CUSIP, "US" + to_string(kBondMapCusip[cusip].first) + "Y", 0., kBondMapCusip[cusip].second);
+// Intern the on-the-run bonds on the first call, later calls do nothing
+void RegisterBondsOnce() {
+    static bool registered = RegisterBonds();
+    (void)registered;
 }
 
-double GetPV01Value(const string& cusip) {
-    return kPV01Map[cusip];
+// Fetch the interned handle of a bond from its cusip
+ProductHandle FetchBondHandle(string_view cusip) {
+    RegisterBondsOnce();
+
+    ProductHandle handle = ProductRegistry<Bond>::Instance().Find(cusip);
+    if (handle == kInvalidProductHandle) {
+        throw invalid_argument("FetchBondHandle: unknown cusip '" + string(cusip) + "'");
+    }
+    return handle;
 }
 
+const Bond& FetchBond(string_view cusip) {
+    return ProductRegistry<Bond>::Instance().Get(FetchBondHandle(cusip));
+}
 
-long GetMillisecond() {
-    auto time_point = chrono::system_clock::now();
-    auto sec = chrono::time_point_cast<chrono::seconds>(time_point);
-    auto millisec = chrono::duration_cast<chrono::milliseconds>(time_point - sec);
-    long millisec_count = millisec.count();
-    return millisec_count;
+const Bond& FetchBond(int maturity) {
+    return FetchBond(kBondMapMaturity.at(maturity).first);
 }
 
 